@@ -0,0 +1,21 @@
+/* Gerado por detective-quest-mestre --gerar-hash-perfeita catalogo_pistas.txt.
+   Não edite: altere o catálogo e gere de novo. */
+#define CATALOGO_N 8
+#define CATALOGO_SLOTS 8
+#define CATALOGO_BALDES 3
+#define CATALOGO_HASH_TESTE 0x031a53034a74b471ULL
+
+static const uint32_t CATALOGO_DESLOC[CATALOGO_BALDES] = { 5, 12, 1 };
+
+static const CatalogoPista CATALOGO_PISTAS[CATALOGO_SLOTS] = {
+    { "Livro sobre mutacoes", 20, "Dr. Silva" },
+    { "Fio de cabelo loiro", 19, "Maria" },
+    { "Frasco quebrado", 15, "Dr. Silva" },
+    { "Pegadas de botas", 16, "Capitão Rocha" },
+    { "Chave enferrujada", 17, "Capitão Rocha" },
+    { "Mapa rasgado", 12, "Maria" },
+    { "Carta rasgada", 13, "Maria" },
+    { "Luvas manchadas", 15, "Dr. Silva" },
+};
+
+static const int CATALOGO_ORDEM[CATALOGO_N ? CATALOGO_N : 1] = { 2, 7, 1, 6, 5, 3, 4, 0 };
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 /*===============================================================
     STRUCTS PRINCIPAIS
@@ -16,6 +17,7 @@ typedef struct Sala {
 
 /* Nó da BST de pistas coletadas */
 typedef struct PistaNode {
+    uint64_t prefixo;    // 8 primeiros bytes da pista em big-endian
     char pista[100];
     struct PistaNode *esq;
     struct PistaNode *dir;
@@ -26,6 +28,18 @@ typedef struct PistaNode {
     FUNÇÕES DA BST DE PISTAS
 ================================================================*/
 
+/* Empacota os 8 primeiros bytes (completando com zeros) em big-endian:
+   comparar os inteiros dá a mesma ordem que o strcmp nesses bytes */
+uint64_t prefixoPista(const char *p) {
+    uint64_t k = 0;
+    int fim = 0;
+    for (int i = 0; i < 8; i++) {
+        if (!p[i]) fim = 1;
+        k = (k << 8) | (fim ? 0 : (unsigned char)p[i]);
+    }
+    return k;
+}
+
 /* Cria um novo nó de pista */
 PistaNode* criarPistaNode(const char *p) {
     PistaNode *novo = (PistaNode*)malloc(sizeof(PistaNode));
@@ -34,21 +48,33 @@ PistaNode* criarPistaNode(const char *p) {
         exit(1);
     }
     strcpy(novo->pista, p);
+    novo->prefixo = prefixoPista(p);
     novo->esq = novo->dir = NULL;
     return novo;
 }
 
+/* Compara a pista p (de prefixo pp) com o nó: o strcmp só roda
+   quando os 8 primeiros bytes empatam, e então começa depois deles */
+int compararPista(const char *p, uint64_t pp, const PistaNode *no) {
+    if (pp != no->prefixo)
+        return pp < no->prefixo ? -1 : 1;
+    if ((pp & 0xff) == 0)
+        return 0;           // menos de 8 bytes: prefixo igual é pista igual
+    return strcmp(p + 8, no->pista + 8);
+}
+
 /* Insere uma pista na BST (ordem alfabética) */
 PistaNode* inserirPista(PistaNode *raiz, const char *p) {
-    if (raiz == NULL) {
-        return criarPistaNode(p);
+    uint64_t pp = prefixoPista(p);
+    PistaNode **pos = &raiz;
+
+    while (*pos != NULL) {
+        int cmp = compararPista(p, pp, *pos);
+        if (cmp == 0)
+            return raiz;    // pista repetida
+        pos = cmp < 0 ? &(*pos)->esq : &(*pos)->dir;
     }
-
-    if (strcmp(p, raiz->pista) < 0)
-        raiz->esq = inserirPista(raiz->esq, p);
-    else if (strcmp(p, raiz->pista) > 0)
-        raiz->dir = inserirPista(raiz->dir, p);
-
+    *pos = criarPistaNode(p);
     return raiz;
 }
 
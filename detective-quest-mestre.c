@@ -1,104 +1,836 @@
+#define _GNU_SOURCE   /* accept4, MADV_* e afins no Linux */
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
 
 /* ---------------------------
    DEFINIÇÕES DE TAMANHOS
    --------------------------- */
-#define MAX_NOME 64
-#define MAX_PISTA 128
-#define HASH_SIZE 31   /* tamanho da tabela hash (primo razoável) */
+#define HASH_CAP_INICIAL 16   /* nº inicial de slots da hash (potência de 2) */
+#define ARENA_BLOCO_MIN 1024        /* primeiro bloco de uma arena */
+#define ARENA_BLOCO (64 * 1024)     /* teto para o crescimento dos blocos */
+
+/* ==========================
+   STRUCT: Arena (alocador por blocos)
+   Objetos são alocados em sequência dentro de blocos grandes e
+   liberados todos de uma vez; não existe free individual.
+   ========================== */
+typedef struct ArenaBloco {
+    struct ArenaBloco *prox;
+    size_t usado;
+    size_t cap;
+    unsigned char dados[];
+} ArenaBloco;
+
+typedef struct Arena {
+    ArenaBloco *atual;     /* bloco em uso; os anteriores seguem por prox */
+} Arena;
+
+/* ==========================
+   Slot de hash (endereçamento aberto)
+   Guarda o hash completo para só comparar chaves quando ele bate.
+   ========================== */
+typedef struct HashSlot {
+    unsigned int hash;
+    int indice;            /* posição da chave; -1 = slot vazio */
+} HashSlot;
+
+/* ==========================
+   STRUCT: Pool de strings internadas
+   Cada texto distinto (nome de sala, pista, suspeito) recebe um id
+   inteiro; as estruturas guardam só o id e comparam ids.
+   Hash de 64 bits e comprimento ficam guardados por id: uma busca só
+   chega ao memcmp quando os dois batem.
+   ========================== */
+typedef struct InternPool {
+    const char **textos;   /* id -> texto (armazenado na arena) */
+    uint64_t *hashes;      /* id -> hash completo do texto */
+    uint32_t *comprimentos;/* id -> strlen do texto */
+    int total;
+    int capTextos;
+    HashSlot *slots;       /* 32 bits baixos do hash -> id */
+    int capacidade;
+    Arena arena;
+    int congelado;         /* 1 = somente leitura (compartilhado entre threads) */
+} InternPool;
+
+#define SEM_PISTA (-1)
 
 /* ==========================
    STRUCT: Sala (árvore)
    ========================== */
 typedef struct Sala {
-    char nome[MAX_NOME];
-    char pista[MAX_PISTA]; /* string vazia "" indica sem pista */
+    int nome;              /* id internado */
+    int pista;             /* id internado ou SEM_PISTA */
     struct Sala *esq;
     struct Sala *dir;
 } Sala;
 
 /* ==========================
-   STRUCT: BST de pistas
+   STRUCT: Mansão plana (vetores indexados)
+   Alternativa à árvore de Salas: as salas ficam em vetores contíguos,
+   numeradas em pré-ordem, com filhos como índices int32 (-1 = nada).
+   Os dados de navegação (filhos + pista) ficam juntos em SalaQuente;
+   o nome, só usado para exibir, fica num vetor à parte.
+   ========================== */
+typedef struct SalaQuente {
+    int32_t esq;
+    int32_t dir;
+    int32_t pista;         /* id internado ou SEM_PISTA */
+} SalaQuente;
+
+/* ==========================
+   STRUCT: Grafo da mansão (CSR)
+   Salas com qualquer número de saídas: as saídas de v são
+   destino[inicio[v] .. inicio[v+1]). Serve às consultas de rota.
+   ========================== */
+typedef struct GrafoMansao {
+    int n;                 /* nº de salas */
+    int m;                 /* nº de arestas (passagens de mão única) */
+    int *inicio;           /* n + 1 posições */
+    int *destino;
+    int *peso;             /* NULL = todas valem 1 (BFS em vez de Dijkstra) */
+} GrafoMansao;
+
+typedef struct MansaoPlana {
+    SalaQuente *salas;
+    int32_t *nomes;        /* id internado do nome de cada sala */
+    int n;                 /* a sala 0 é a entrada */
+    int idSaida;           /* id internado de "Saída" (-1 se não há) */
+    const GrafoMansao *grafo; /* caminhos + passagens extras; NULL = sem rotas */
+} MansaoPlana;
+
+/* ==========================
+   ARQUIVO DE MANSÃO (.dqm)
+   Layout binário pensado para mmap, tudo em little-endian:
+     cabeçalho | nSalas registros | nTextos offsets | textos
+   Os textos são strings terminadas em '\0', sem repetição; os
+   registros apontam para eles por índice. A sala 0 é a raiz.
+   ========================== */
+#define DQM_MAGICA "DQM1"
+#define DQM_VERSAO 1
+
+typedef struct DqmCabecalho {
+    char magica[4];
+    uint32_t versao;
+    uint32_t nSalas;
+    uint32_t nTextos;
+} DqmCabecalho;
+
+typedef struct DqmSala {
+    int32_t esq;           /* índice da sala; -1 = sem caminho */
+    int32_t dir;
+    int32_t nome;          /* índice do texto */
+    int32_t pista;         /* índice do texto; -1 = sem pista */
+} DqmSala;
+
+/* ==========================
+   STRUCT: BST de pistas (AVL)
+   O prefixo decide a maioria das comparações sem ler os textos.
    ========================== */
 typedef struct PistaNode {
-    char pista[MAX_PISTA];
+    uint64_t prefixo;      /* 8 primeiros bytes do texto, big-endian */
+    int pista;             /* id internado */
+    int altura;            /* altura da subárvore (folha = 1) */
     struct PistaNode *esq;
     struct PistaNode *dir;
 } PistaNode;
 
 /* ==========================
-   STRUCT: Entrada da Hash (encadeada)
-   key = pista, value = suspeito
+   STRUCT: Cursor em ordem sobre a BST de pistas
+   Pilha fixa com os ancestrais ainda não visitados: a AVL tem altura
+   < 1,45 log2(n + 2), então 64 níveis cobrem qualquer n int. Não
+   altera a árvore (Morris/threaded alterariam), não aloca e pode
+   parar e continuar a qualquer momento.
+   ========================== */
+#define CURSOR_ALTURA_MAX 64
+
+typedef struct CursorPistas {
+    const PistaNode *pilha[CURSOR_ALTURA_MAX];
+    int topo;
+} CursorPistas;
+
+/* ==========================
+   STRUCT: Placar de suspeitos
+   Contadores de evidência por suspeito, atualizados a cada pista nova,
+   e um max-heap indexado para responder "top-k" sem varrer a BST.
+   ========================== */
+typedef struct Placar {
+    int *contagem;         /* id do suspeito -> nº de pistas coletadas */
+    int *posHeap;          /* id do suspeito -> posição no heap, -1 = fora */
+    int *heap;             /* ids de suspeitos, maior contagem na raiz */
+    int tamHeap;
+    int cap;               /* tamanho dos vetores indexados por id */
+} Placar;
+
+/* ==========================
+   STRUCT: Arena dos ramos de uma investigação
+   A BST de pistas da sessão é persistente: inserir copia só o caminho
+   até o ponto de inserção e nunca altera um nó existente. Versões
+   antigas (para desfazer) e ramos abertos a partir da sessão dividem
+   as subárvores que não mudaram, todas nesta arena, que só é liberada
+   quando o último ramo é liberado.
+   ========================== */
+typedef struct ArenaRamos {
+    Arena arena;
+    int refs;              /* investigações que usam a arena */
+} ArenaRamos;
+
+/* Um movimento do histórico: também imutável depois de completo, então
+   ramos dividem o histórico até o ponto em que se separaram. */
+typedef struct Passo {
+    struct Passo *anterior;
+    PistaNode *pistas;     /* versão da BST antes do movimento */
+    int sala;              /* sala de onde o jogador saiu */
+    int creditado;         /* suspeito creditado ao entrar no destino; -1 = nenhum */
+    int coletada;          /* entrada da hash da pista coletada no destino; -1 = nenhuma */
+} Passo;
+
+#define CREDITO_PENDENTE (-2)  /* movimento cuja sala de destino não foi visitada */
+
+/* ==========================
+   STRUCT: Investigação (sessão de um jogador)
+   Os nós da BST e o histórico de movimentos ficam em nos (criada sob
+   demanda por arenaDaInvestigacao).
+   ========================== */
+typedef struct Investigacao {
+    PistaNode *pistas;
+    ArenaRamos *nos;
+    Passo *historico;      /* último movimento; NULL = nada a desfazer */
+    Placar placar;
+    uint64_t *coletadas;   /* bit e = pista da entrada e da hash coletada; o placar
+                              só muda quando um bit muda (marcarColetada) */
+    int palavrasColetadas;
+    int salaAtual;         /* cursor na mansão (índice da sala) */
+    int retomarEm;         /* sala onde a próxima exploração começa; -1 = entrada */
+    int acusado;           /* id do último acusado; -1 = nenhuma acusação */
+    int acertou;           /* veredito da última acusação */
+} Investigacao;
+
+/* ==========================
+   ARQUIVO DE INVESTIGAÇÃO (.dqs)
+   Partida salva, também pensada para mmap (little-endian):
+     cabeçalho | nTextos entradas | textos
+   Os textos 0..nPistas-1 são as pistas coletadas em ordem alfabética,
+   o que permite remontar a AVL balanceada em O(n) sem comparar nada;
+   o acusado, se houver, vem logo depois.
+   ========================== */
+#define DQS_MAGICA "DQS1"
+#define DQS_VERSAO 1
+
+typedef struct DqsCabecalho {
+    char magica[4];
+    uint32_t versao;
+    uint32_t nSalas;       /* da mansão em que a partida foi salva */
+    int32_t salaAtual;
+    int32_t acusado;       /* índice do texto; -1 = nenhuma acusação */
+    uint32_t acertou;
+    uint32_t nPistas;
+    uint32_t nTextos;      /* nPistas + 1 se houver acusado */
+} DqsCabecalho;
+
+typedef struct DqsTexto {
+    uint32_t offset;       /* a partir do início dos textos */
+    uint32_t comprimento;  /* sem o '\0' final */
+} DqsTexto;
+
+/* ==========================
+   STRUCT: Leitor bufferizado
+   Usado no modo lote para ler os movimentos sem scanf.
+   ========================== */
+#define LEITOR_BUF (64 * 1024)
+
+typedef struct Leitor {
+    FILE *f;
+    size_t pos;
+    size_t tam;
+    unsigned char buf[LEITOR_BUF];
+} Leitor;
+
+#define OPCAO_FIM (-1)        /* entrada acabou */
+#define OPCAO_INVALIDA (-2)   /* token que não é número */
+
+/* ==========================
+   STRUCT: Entrada da Hash
+   key = pista, value = suspeito (ambos ids internados)
+   ant/prox encadeiam as entradas do mesmo suspeito numa lista
+   circular, em ordem de inserção (índice reverso suspeito -> pistas).
    ========================== */
 typedef struct HashEntry {
-    char pista[MAX_PISTA];
-    char suspeito[MAX_NOME];
-    struct HashEntry *prox;
+    int pista;
+    int suspeito;
+    int ant, prox;         /* índices de entradas do mesmo suspeito */
 } HashEntry;
 
 /* ==========================
-   Tabela Hash (array de ponteiros)
+   Tabela Hash (endereçamento aberto, sondagem linear)
+   As entradas ficam contíguas em ordem de inserção; os slots só
+   apontam para elas, então o rehash não move as entradas.
    ========================== */
+#define SUSPEITO_AUSENTE (-2)  /* suspeito que nunca teve pistas */
+
+/* Linha de evidências de um suspeito, esparsa: só as palavras de 64
+   entradas em que ele tem alguma pista, em ordem de palavra. Ocupa
+   O(pistas dele), não O(entradas da tabela). */
+typedef struct PalavraEvidencia {
+    int palavra;           /* entradas palavra*64 .. palavra*64+63 */
+    uint64_t bits;
+} PalavraEvidencia;
+
+typedef struct LinhaEvidencias {
+    PalavraEvidencia *p;
+    int n, cap;
+} LinhaEvidencias;
+
 typedef struct HashTable {
-    HashEntry *buckets[HASH_SIZE];
+    HashEntry *entradas;
+    int tamanho;           /* nº de entradas em uso */
+    int capEntradas;
+    HashSlot *slots;
+    int capacidade;        /* nº de slots (potência de 2) */
+    int *primeiraPista;    /* id do suspeito -> 1ª entrada; -1 = lista vazia */
+    int capSuspeitos;      /* tamanho de primeiraPista */
+    int *suspeitos;        /* registro: ids com lista, na ordem em que apareceram */
+    int nSuspeitos;
+    int *indiceSuspeito;   /* id do suspeito -> posição em suspeitos (id denso) */
+    LinhaEvidencias *evidencias; /* uma linha por suspeito denso */
+    int capLinhas;
+    int usaCatalogo;       /* 1 = carregou o catálogo estático (consultá-lo nas buscas) */
+    int catalogoSobreposto;/* 1 = alguma pista do catálogo estático foi remapeada */
 } HashTable;
 
+/* ==========================
+   CATÁLOGO ESTÁTICO (hash perfeita)
+   catalogo_pistas.h é gerado a partir de catalogo_pistas.txt com
+     detective-quest-mestre --gerar-hash-perfeita catalogo_pistas.txt
+   e traz as pistas fixas do jogo numa tabela sem colisões (CHD): o
+   balde (h >> 32) % CATALOGO_BALDES escolhe um deslocamento d e a pista
+   só pode estar no slot misturarHash(h, d) % CATALOGO_SLOTS, onde h é
+   hashBytes do texto. Uma busca é um hash e um memcmp.
+   ========================== */
+typedef struct CatalogoPista {
+    const char *pista;     /* NULL = slot vazio */
+    uint32_t comprimento;
+    const char *suspeito;
+} CatalogoPista;
+
+#include "catalogo_pistas.h"
+
+/* ==========================
+   STRUCT: Tabela concorrente (catálogos grandes)
+   Encadeamento separado sobre um vetor de baldes alocado de uma vez
+   (sem rehash). Inserir é prepender o nó com CAS na cabeça do balde e
+   ler é seguir ponteiros publicados com release, então buscas não
+   travam nada enquanto a carga paralela escreve. Cada worker aloca os
+   nós na sua arena. As chaves são texto: o pool de strings tem um
+   escritor só.
+   Nada é copiado do catálogo: o arquivo fica mapeado (MAP_SHARED, só
+   leitura) e cada entrada aponta para a linha "pista;suspeito" que
+   vale. Pista e suspeito são visões (ponteiro + comprimento) dessa
+   linha, sem '\0'. O arquivo não pode ser truncado enquanto mapeado.
+   O servidor mantém a tabela até o fim e responde o SUSPEITO de cada
+   pista por ela, então servidores com o mesmo catálogo dividem as
+   páginas; o jogo local só a usa na carga (importarCatalogo copia
+   para o pool o nome dos suspeitos das pistas das salas).
+   ========================== */
+typedef struct EntradaConc {
+    struct EntradaConc *prox;  /* imutável depois de publicado */
+    uint64_t hash;
+    const char *linha;         /* linha mais tardia da pista; trocada com CAS */
+    uint32_t comprimento;      /* da pista, no início de linha */
+} EntradaConc;
+
+typedef struct TabelaConcorrente {
+    EntradaConc **baldes;
+    size_t nBaldes;        /* potência de 2 */
+    long n;                /* pistas distintas */
+    const char *mapa;      /* o catálogo mapeado; NULL = nenhum */
+    size_t tamMapa;
+    Arena *arenas;         /* uma por worker da última carga */
+    int nArenas;
+} TabelaConcorrente;
+
+/* ==========================
+   STRUCT: Mundo sintético (gerador e teste de escala)
+   ========================== */
+typedef struct Mundo {
+    int nSalas;
+    const char *forma;     /* "balanceada", "torta" ou "corrente" */
+    int nPistas;           /* pistas do catálogo */
+    int nSuspeitos;
+    const char *dist;      /* suspeitos das pistas: "uniforme" ou "zipf" */
+    uint64_t semente;
+} Mundo;
+
 /* ==========================
    PROTÓTIPOS
    ========================== */
-Sala* criarSala(const char *nome, const char *pista);
-Sala* montarMansao(void);
+void inicializarArena(Arena *a);
+void* arenaAlocar(Arena *a, size_t n);
+void liberarArena(Arena *a);
+
+void inicializarInternos(void);
+int internar(const char *s);
+int internarN(const char *s, size_t n);
+int buscarIdInterno(const char *s);
+const char* textoInterno(int id);
+size_t comprimentoInterno(int id);
+void congelarInternos(void);
+void liberarInternos(void);
+
+Sala* criarSala(Arena *a, const char *nome, const char *pista);
+Sala* montarMansao(Arena *a);
+void planificarMansao(Arena *a, Sala *raiz, MansaoPlana *m);
+int carregarMansao(Arena *a, const char *caminho, MansaoPlana *m);
+int salvarMansao(const MansaoPlana *m, const char *caminho);
 
-PistaNode* criarPistaNode(const char *p);
-PistaNode* inserirPistaBST(PistaNode *raiz, const char *p);
-int existePistaBST(PistaNode *raiz, const char *p);
+void construirGrafo(GrafoMansao *g, int n, const int *orig, const int *dest, const int *peso, int m);
+int grafoDaMansao(GrafoMansao *g, const MansaoPlana *m, const char *arqPassagens);
+int rotaMaisCurta(const GrafoMansao *g, int origem, int (*alvo)(int sala, const void *ctx),
+                  const void *ctx, int *rota, int max, long long *custo);
+void liberarGrafo(GrafoMansao *g);
+
+uint64_t prefixoPista(int p);
+PistaNode* criarPistaNode(Arena *a, int p);
+PistaNode* inserirPistaBST(Arena *a, PistaNode *raiz, int p);
+int inserirOuEncontrar(Arena *a, PistaNode **raiz, int p);
+int inserirPersistente(Arena *a, PistaNode **raiz, int p);
+int existePistaBST(PistaNode *raiz, int p);
 void exibirPistasInOrder(PistaNode *raiz);
-void liberarPistasBST(PistaNode *raiz);
+void iniciarCursor(CursorPistas *c, const PistaNode *raiz);
+int proximaPista(CursorPistas *c);
+int proximasPistas(CursorPistas *c, int *saida, int max);
+int buscarPistasIntervalo(PistaNode *raiz, const char *de, const char *ate, int *saida, int max);
+int buscarPistasPrefixo(PistaNode *raiz, const char *prefixo, int *saida, int max);
+
+void inicializarInvestigacao(Investigacao *inv);
+void liberarInvestigacao(Investigacao *inv);
+Arena* arenaDaInvestigacao(Investigacao *inv);
+void ramificarInvestigacao(Investigacao *ramo, const Investigacao *origem);
+
+void registrarEvidencia(Placar *p, int suspeito);
+void retirarEvidencia(Placar *p, int suspeito);
+int evidenciasContra(const Placar *p, int suspeito);
+int topSuspeitos(const Placar *p, int k, int *saida);
 
 void inicializarHash(HashTable *ht);
-unsigned int hashString(const char *s);
+uint64_t hashBytes(const char *s, size_t n);
+uint64_t hashString(const char *s);
 void inserirMapping(HashTable *ht, const char *pista, const char *suspeito);
 const char* buscarSuspeitoPorPista(HashTable *ht, const char *pista);
+const char* buscarSuspeitoCatalogo(const char *pista, size_t n, uint64_t h);
+void carregarCatalogoEstatico(HashTable *ht);
+int gerarHashPerfeita(const char *caminho, FILE *saida);
+void inicializarTabelaConcorrente(TabelaConcorrente *t, size_t capacidade);
+int inserirConcorrente(TabelaConcorrente *t, Arena *a, const char *linha, size_t n);
+const char* buscarSuspeitoConcorrente(const TabelaConcorrente *t, const char *pista,
+                                      size_t n, uint64_t h, size_t *ns);
+int carregarCatalogoParalelo(TabelaConcorrente *t, const char *caminho, int nThreads);
+void importarCatalogo(HashTable *ht, const TabelaConcorrente *t, const MansaoPlana *m);
+void liberarTabelaConcorrente(TabelaConcorrente *t);
+int buscarSuspeitoId(HashTable *ht, int pista);
+int buscarEntradaPista(const HashTable *ht, int pista);
+int listarPistasDoSuspeito(const HashTable *ht, int suspeito, int *saida, int max);
+void listarAssociacoes(const HashTable *ht);
 void liberarHash(HashTable *ht);
 
-void explorar(Sala *inicio, HashTable *ht, PistaNode **pistasColetadas);
-void fazerAcusacao(PistaNode *pistasColetadas, HashTable *ht);
+int visitarSala(const MansaoPlana *m, HashTable *ht, Investigacao *inv, int sala);
+int fimDaExploracao(const MansaoPlana *m, int sala);
+void registrarMovimento(Investigacao *inv);
+int desfazerMovimento(Investigacao *inv);
+int salvarInvestigacao(const Investigacao *inv, const MansaoPlana *m, const char *caminho);
+int carregarInvestigacao(Investigacao *inv, const MansaoPlana *m, HashTable *ht,
+                         const char *caminho);
+void pontuarSuspeitos(const HashTable *ht, const Investigacao *inv, int *pontos);
+int evidenciasDoSuspeito(const HashTable *ht, const Investigacao *inv, int suspeito);
+int acusar(const HashTable *ht, Investigacao *inv, int suspeito);
+void explorar(const MansaoPlana *m, HashTable *ht, Investigacao *inv);
+void fazerAcusacao(const HashTable *ht, Investigacao *inv);
+void exibirSuspeitosProvaveis(const Placar *p, int k);
+void relatarEstatisticas(FILE *f, const HashTable *ht, const Investigacao *inv);
 
 void limparBuffer(void);
+int lerOpcao(void);
+int lerLinha(char *buf, int tam);
+int lerInteiro(Leitor *l);
+int jogarSessao(const MansaoPlana *m, HashTable *ht, Investigacao *inv);
+int executarBenchmark(int n, const char *dist);
+int gerarArquivosMundo(const Mundo *w, const char *prefixo);
+int executarEscala(const Mundo *w, int sessoes);
+int executarServidor(const MansaoPlana *m, HashTable *ht, const TabelaConcorrente *catalogo,
+                     const char *caminho, int nThreads);
+int resolverMansao(const MansaoPlana *m, HashTable *ht, int nThreads);
 
 /* ==========================
    IMPLEMENTAÇÃO
    ========================== */
 
-Sala* criarSala(const char *nome, const char *pista) {
-    Sala *s = (Sala*) malloc(sizeof(Sala));
-    if (!s) exit(1);
+/* ==========================
+   ENTRADA E SAÍDA
+   No modo lote as opções vêm de um Leitor e os prompts são omitidos;
+   só o resultado de cada sessão é impresso.
+   ========================== */
+
+static int modoLote = 0;
+static Leitor *entradaLote = NULL;
 
-    strncpy(s->nome, nome, MAX_NOME - 1);
-    s->nome[MAX_NOME - 1] = '\0';
+#define SAIDA(...) do { if (!modoLote) printf(__VA_ARGS__); } while (0)
 
-    if (pista)
-        strncpy(s->pista, pista, MAX_PISTA - 1);
-    else
-        s->pista[0] = '\0';
+static int proximoByte(Leitor *l) {
+    if (l->pos == l->tam) {
+        l->tam = fread(l->buf, 1, LEITOR_BUF, l->f);
+        l->pos = 0;
+        if (l->tam == 0) return EOF;
+    }
+    return l->buf[l->pos++];
+}
+
+/* Próximo inteiro separado por espaços/quebras de linha; OPCAO_FIM no
+   fim da entrada e OPCAO_INVALIDA para tokens que não são números. */
+int lerInteiro(Leitor *l) {
+    int c;
+    do c = proximoByte(l);
+    while (c == ' ' || c == '\n' || c == '\t' || c == '\r');
+    if (c == EOF) return OPCAO_FIM;
+
+    int neg = 0, v = 0, digitos = 0, lixo = 0;
+    if (c == '-') { neg = 1; c = proximoByte(l); }
+    while (c != EOF && c != ' ' && c != '\n' && c != '\t' && c != '\r') {
+        if (c >= '0' && c <= '9' && v < 100000000) { v = v * 10 + (c - '0'); digitos++; }
+        else lixo = 1;
+        c = proximoByte(l);
+    }
+    if (lixo || !digitos) return OPCAO_INVALIDA;
+    return neg ? -v : v;
+}
+
+/* Lê a próxima opção de menu, do terminal ou do lote. */
+int lerOpcao(void) {
+    if (modoLote) return lerInteiro(entradaLote);
+
+    int op;
+    int r = scanf("%d", &op);
+    if (r == EOF) return OPCAO_FIM;
+    limparBuffer();
+    return r == 1 ? op : OPCAO_INVALIDA;
+}
+
+/* Lê uma linha de texto (sem o '\n'), do terminal ou do lote.
+   Retorna o comprimento ou -1 se a entrada acabou. */
+int lerLinha(char *buf, int tam) {
+    int n = 0, c;
+    if (modoLote) {
+        while ((c = proximoByte(entradaLote)) != EOF && c != '\n')
+            if (n < tam - 1) buf[n++] = (char) c;
+    } else {
+        while ((c = getchar()) != EOF && c != '\n')
+            if (n < tam - 1) buf[n++] = (char) c;
+    }
+    if (n > 0 && buf[n - 1] == '\r') n--;
+    buf[n] = '\0';
+    return (c == EOF && n == 0) ? -1 : n;
+}
+
+/* ==========================
+   INSTRUMENTAÇÃO
+   Contadores do que as estruturas fazem: sondagens nas tabelas,
+   comparações e altura da AVL, alocações e tempo nas fases do jogo.
+   Ficam desligados até DQ_STATS estar definida no ambiente (ou sempre
+   ligados se compilado com -DDQ_INSTRUMENTACAO). As somas são atômicas
+   relaxadas porque os workers do servidor atualizam em paralelo.
+   ========================== */
+#ifdef DQ_INSTRUMENTACAO
+static int estatAtiva = 1;
+#else
+static int estatAtiva = 0;
+#endif
+
+#define ESTAT_FAIXAS 7   /* sondagens: 0, 1, 2-3, 4-7, 8-15, 16-31, 32+ */
+
+typedef struct EstatTabela {
+    long operacoes;
+    long sondagens;        /* slots visitados além do primeiro */
+    long maxSondagens;
+    long faixas[ESTAT_FAIXAS];
+} EstatTabela;
+
+typedef struct Estatisticas {
+    EstatTabela pistas;    /* HashTable pista -> suspeito */
+    EstatTabela internos;  /* pool de strings */
+    long buscasSuspeito;   /* chamadas de buscarSuspeitoPorPista */
+    long insercoesBST, comparacoesInsercao;
+    long buscasBST, comparacoesBusca;
+    long maxAlturaBST;
+    long salasCriadas, nosPistaCriados, entradasCriadas;
+    long blocosArena, bytesArena, redimensionamentos;
+    long chamadasExplorar, nsExplorar;   /* sem o tempo da acusação */
+    long chamadasAcusacao, nsAcusacao;
+} Estatisticas;
+
+static Estatisticas estat;
+
+#define ESTAT_SOMA(campo, v) \
+    do { if (estatAtiva) __atomic_fetch_add(&estat.campo, (v), __ATOMIC_RELAXED); } while (0)
+#define ESTAT_MAX(campo, v) \
+    do { if (estatAtiva) estatMax(&estat.campo, (v)); } while (0)
+#define ESTAT_SONDAGEM(tabela, n) \
+    do { if (estatAtiva) registrarSondagem(&estat.tabela, (n)); } while (0)
+
+static void estatMax(long *campo, long v) {
+    long atual = __atomic_load_n(campo, __ATOMIC_RELAXED);
+    while (v > atual &&
+           !__atomic_compare_exchange_n(campo, &atual, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static int faixaSondagem(long n) {
+    int f = 0;
+    while (n > 0 && f < ESTAT_FAIXAS - 1) {
+        n >>= 1;
+        f++;
+    }
+    return f;
+}
+
+static void registrarSondagem(EstatTabela *t, long n) {
+    __atomic_fetch_add(&t->operacoes, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&t->sondagens, n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&t->faixas[faixaSondagem(n)], 1, __ATOMIC_RELAXED);
+    estatMax(&t->maxSondagens, n);
+}
+
+static double agoraNs(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/* ==========================
+   ARENA
+   ========================== */
+
+void inicializarArena(Arena *a) {
+    a->atual = NULL;
+}
+
+void* arenaAlocar(Arena *a, size_t n) {
+    n = (n + 15) & ~(size_t)15;   /* mantém alinhamento de 16 bytes */
+
+    ArenaBloco *b = a->atual;
+    if (!b || b->usado + n > b->cap) {
+        /* blocos dobram até ARENA_BLOCO: arenas pequenas (uma por sessão)
+           não reservam 64 KiB logo na primeira alocação */
+        size_t cap = b ? b->cap * 2 : ARENA_BLOCO_MIN;
+        if (cap > ARENA_BLOCO) cap = ARENA_BLOCO;
+        if (cap < n) cap = n;
+        b = malloc(sizeof(ArenaBloco) + cap);
+        if (!b) exit(1);
+        ESTAT_SOMA(blocosArena, 1);
+        ESTAT_SOMA(bytesArena, (long) cap);
+        b->usado = 0;
+        b->cap = cap;
+        b->prox = a->atual;
+        a->atual = b;
+    }
+
+    void *p = b->dados + b->usado;
+    b->usado += n;
+    return p;
+}
+
+void liberarArena(Arena *a) {
+    ArenaBloco *b = a->atual;
+    while (b) {
+        ArenaBloco *prox = b->prox;
+        free(b);
+        b = prox;
+    }
+    a->atual = NULL;
+}
+
+/* ==========================
+   STRINGS INTERNADAS
+   ========================== */
+
+static InternPool internos;
+
+static HashSlot* alocarSlots(int capacidade) {
+    HashSlot *slots = malloc(capacidade * sizeof(HashSlot));
+    if (!slots) exit(1);
+    for (int i = 0; i < capacidade; i++)
+        slots[i].indice = -1;
+    return slots;
+}
+
+/* Reinsere slots ocupados numa tabela com o dobro do tamanho. */
+static HashSlot* dobrarSlots(HashSlot *slots, int *capacidade) {
+    int novaCap = *capacidade * 2;
+    HashSlot *novos = alocarSlots(novaCap);
+    ESTAT_SOMA(redimensionamentos, 1);
+    unsigned int mask = novaCap - 1;
+
+    for (int j = 0; j < *capacidade; j++) {
+        if (slots[j].indice == -1) continue;
+        unsigned int i = slots[j].hash & mask;
+        while (novos[i].indice != -1)
+            i = (i + 1) & mask;
+        novos[i] = slots[j];
+    }
+
+    free(slots);
+    *capacidade = novaCap;
+    return novos;
+}
+
+void inicializarInternos(void) {
+    internos.total = 0;
+    internos.capTextos = HASH_CAP_INICIAL;
+    internos.textos = malloc(internos.capTextos * sizeof(const char*));
+    internos.hashes = malloc(internos.capTextos * sizeof(uint64_t));
+    internos.comprimentos = malloc(internos.capTextos * sizeof(uint32_t));
+    if (!internos.textos || !internos.hashes || !internos.comprimentos) exit(1);
+    internos.capacidade = HASH_CAP_INICIAL;
+    internos.slots = alocarSlots(internos.capacidade);
+    inicializarArena(&internos.arena);
+    internos.congelado = 0;
+}
+
+/* A partir daqui o pool só é lido; internar um texto novo é erro. */
+void congelarInternos(void) {
+    internos.congelado = 1;
+}
+
+static unsigned int localizarInterno(const char *s, size_t n, uint64_t h) {
+    unsigned int mask = internos.capacidade - 1;
+    unsigned int i = (unsigned int) h & mask;
+    long sond = 0;
+    while (internos.slots[i].indice != -1) {
+        int id = internos.slots[i].indice;
+        if (internos.slots[i].hash == (unsigned int) h && internos.hashes[id] == h &&
+            internos.comprimentos[id] == n && memcmp(internos.textos[id], s, n) == 0)
+            break;
+        i = (i + 1) & mask;
+        sond++;
+    }
+    ESTAT_SONDAGEM(internos, sond);
+    return i;
+}
+
+static int internarComHash(const char *s, size_t n, uint64_t h);
+
+/* Devolve o id de s, registrando uma cópia se ainda não existir. */
+int internar(const char *s) {
+    return internarN(s, strlen(s));
+}
+
+/* Como internar, para quem já sabe o comprimento (s[n] == '\0'). */
+int internarN(const char *s, size_t n) {
+    return internarComHash(s, n, hashBytes(s, n));
+}
+
+/* Como internarN, reaproveitando h = hashBytes(s, n). */
+static int internarComHash(const char *s, size_t n, uint64_t h) {
+    unsigned int i = localizarInterno(s, n, h);
+    if (internos.slots[i].indice != -1)
+        return internos.slots[i].indice;
+    if (internos.congelado) {
+        fprintf(stderr, "internar: pool congelado (\"%s\")\n", s);
+        exit(1);
+    }
+
+    if ((internos.total + 1) * 4 > internos.capacidade * 3) {
+        internos.slots = dobrarSlots(internos.slots, &internos.capacidade);
+        i = localizarInterno(s, n, h);
+    }
+    if (internos.total == internos.capTextos) {
+        internos.capTextos *= 2;
+        internos.textos = realloc(internos.textos, internos.capTextos * sizeof(const char*));
+        internos.hashes = realloc(internos.hashes, internos.capTextos * sizeof(uint64_t));
+        internos.comprimentos = realloc(internos.comprimentos, internos.capTextos * sizeof(uint32_t));
+        if (!internos.textos || !internos.hashes || !internos.comprimentos) exit(1);
+    }
 
-    s->pista[MAX_PISTA - 1] = '\0';
+    char *copia = arenaAlocar(&internos.arena, n + 1);
+    memcpy(copia, s, n + 1);
+
+    int id = internos.total++;
+    internos.textos[id] = copia;
+    internos.hashes[id] = h;
+    internos.comprimentos[id] = (uint32_t) n;
+    internos.slots[i].hash = (unsigned int) h;
+    internos.slots[i].indice = id;
+    return id;
+}
+
+/* Como internar, mas sem registrar: -1 se o texto nunca foi visto. */
+int buscarIdInterno(const char *s) {
+    size_t n = strlen(s);
+    unsigned int i = localizarInterno(s, n, hashBytes(s, n));
+    return internos.slots[i].indice;
+}
+
+const char* textoInterno(int id) {
+    return internos.textos[id];
+}
+
+size_t comprimentoInterno(int id) {
+    return internos.comprimentos[id];
+}
+
+void liberarInternos(void) {
+    free(internos.textos);
+    free(internos.hashes);
+    free(internos.comprimentos);
+    free(internos.slots);
+    liberarArena(&internos.arena);
+    internos.textos = NULL;
+    internos.hashes = NULL;
+    internos.comprimentos = NULL;
+    internos.slots = NULL;
+    internos.total = internos.capTextos = internos.capacidade = 0;
+}
+
+/* ==========================
+   MANSÃO
+   ========================== */
+
+Sala* criarSala(Arena *a, const char *nome, const char *pista) {
+    Sala *s = arenaAlocar(a, sizeof(Sala));
+    ESTAT_SOMA(salasCriadas, 1);
+    s->nome = internar(nome);
+    s->pista = (pista && pista[0]) ? internar(pista) : SEM_PISTA;
     s->esq = s->dir = NULL;
     return s;
 }
 
-Sala* montarMansao(void) {
-    Sala *hall = criarSala("Hall de Entrada", "Pegadas de botas");
-    Sala *corredor = criarSala("Corredor Longo", "");
-    Sala *laboratorio = criarSala("Laboratório", "Frasco quebrado");
-    Sala *biblioteca = criarSala("Biblioteca", "Livro sobre mutacoes");
-    Sala *quarto = criarSala("Quarto Abandonado", "Luvas manchadas");
-    Sala *jardim = criarSala("Jardim Interno", "Fio de cabelo loiro");
-    Sala *poco = criarSala("Poço Antigo", "Carta rasgada");
-    Sala *armario = criarSala("Armário Trancado", "Chave enferrujada");
-    Sala *saida = criarSala("Saída", "Mapa rasgado");
+Sala* montarMansao(Arena *a) {
+    Sala *hall = criarSala(a, "Hall de Entrada", "Pegadas de botas");
+    Sala *corredor = criarSala(a, "Corredor Longo", "");
+    Sala *laboratorio = criarSala(a, "Laboratório", "Frasco quebrado");
+    Sala *biblioteca = criarSala(a, "Biblioteca", "Livro sobre mutacoes");
+    Sala *quarto = criarSala(a, "Quarto Abandonado", "Luvas manchadas");
+    Sala *jardim = criarSala(a, "Jardim Interno", "Fio de cabelo loiro");
+    Sala *poco = criarSala(a, "Poço Antigo", "Carta rasgada");
+    Sala *armario = criarSala(a, "Armário Trancado", "Chave enferrujada");
+    Sala *saida = criarSala(a, "Saída", "Mapa rasgado");
 
     hall->esq = laboratorio;
     hall->dir = biblioteca;
@@ -116,245 +848,3722 @@ Sala* montarMansao(void) {
 }
 
 /* ==========================
-   BST DE PISTAS
+   MANSÃO PLANA
    ========================== */
 
-PistaNode* criarPistaNode(const char *p) {
-    PistaNode *no = malloc(sizeof(PistaNode));
-    strncpy(no->pista, p, MAX_PISTA - 1);
-    no->pista[MAX_PISTA - 1] = '\0';
-    no->esq = no->dir = NULL;
-    return no;
+static void alocarMansaoPlana(Arena *a, MansaoPlana *m, int n) {
+    m->n = n;
+    m->idSaida = buscarIdInterno("Saída");
+    m->grafo = NULL;
+    m->salas = arenaAlocar(a, (size_t) n * sizeof(SalaQuente));
+    m->nomes = arenaAlocar(a, (size_t) n * sizeof(int32_t));
 }
 
-int existePistaBST(PistaNode *raiz, const char *p) {
-    if (!raiz) return 0;
-    int cmp = strcmp(p, raiz->pista);
-    if (cmp == 0) return 1;
-    else if (cmp < 0) return existePistaBST(raiz->esq, p);
-    else return existePistaBST(raiz->dir, p);
-}
+/* Copia a árvore para vetores em pré-ordem: o filho esquerdo fica logo
+   após o pai, então descidas pela esquerda andam na memória contígua. */
+void planificarMansao(Arena *a, Sala *raiz, MansaoPlana *m) {
+    typedef struct { Sala *sala; int pai; int lado; } Pendente;
 
-PistaNode* inserirPistaBST(PistaNode *raiz, const char *p) {
-    if (!raiz) return criarPistaNode(p);
-    int cmp = strcmp(p, raiz->pista);
-    if (cmp < 0) raiz->esq = inserirPistaBST(raiz->esq, p);
-    else if (cmp > 0) raiz->dir = inserirPistaBST(raiz->dir, p);
-    return raiz;
-}
+    int n = 0, topo = 0, cap = 64;
+    Pendente *pilha = malloc(cap * sizeof(Pendente));
+    if (!pilha) exit(1);
 
-void exibirPistasInOrder(PistaNode *raiz) {
-    if (!raiz) return;
-    exibirPistasInOrder(raiz->esq);
-    printf(" - %s\n", raiz->pista);
-    exibirPistasInOrder(raiz->dir);
-}
+    /* primeira passada só conta, para alocar os vetores de uma vez */
+    if (raiz) pilha[topo++] = (Pendente) { raiz, -1, 0 };
+    while (topo > 0) {
+        Sala *s = pilha[--topo].sala;
+        n++;
+        if (topo + 2 > cap) {
+            cap *= 2;
+            pilha = realloc(pilha, cap * sizeof(Pendente));
+            if (!pilha) exit(1);
+        }
+        if (s->dir) pilha[topo++].sala = s->dir;
+        if (s->esq) pilha[topo++].sala = s->esq;
+    }
+    alocarMansaoPlana(a, m, n);
 
-void liberarPistasBST(PistaNode *raiz) {
-    if (!raiz) return;
-    liberarPistasBST(raiz->esq);
-    liberarPistasBST(raiz->dir);
-    free(raiz);
+    /* segunda passada: o pai recebe o índice do filho quando este sai */
+    n = 0;
+    if (raiz) pilha[topo++] = (Pendente) { raiz, -1, 0 };
+    while (topo > 0) {
+        Pendente p = pilha[--topo];
+        int i = n++;
+        m->salas[i].esq = m->salas[i].dir = -1;
+        m->salas[i].pista = p.sala->pista;
+        m->nomes[i] = p.sala->nome;
+        if (p.pai != -1) {
+            if (p.lado == 0) m->salas[p.pai].esq = i;
+            else m->salas[p.pai].dir = i;
+        }
+        if (p.sala->dir) pilha[topo++] = (Pendente) { p.sala->dir, i, 1 };
+        if (p.sala->esq) pilha[topo++] = (Pendente) { p.sala->esq, i, 0 };
+    }
+    free(pilha);
 }
 
-/* ==========================
-   HASH TABLE
-   ========================== */
+/* Lê um arquivo .dqm via mmap direto para a mansão plana, numa única
+   passada. Cada texto distinto é internado uma vez. Retorna 0 se deu
+   certo e -1 se o arquivo não existe ou é inválido. */
+int carregarMansao(Arena *a, const char *caminho, MansaoPlana *m) {
+    int fd = open(caminho, O_RDONLY);
+    if (fd < 0) return -1;
 
-void inicializarHash(HashTable *ht) {
-    for (int i = 0; i < HASH_SIZE; i++)
-        ht->buckets[i] = NULL;
-}
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(DqmCabecalho)) {
+        close(fd);
+        return -1;
+    }
+    size_t tam = st.st_size;
+    const unsigned char *mapa = mmap(NULL, tam, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED) return -1;
+    madvise((void*) mapa, tam, MADV_SEQUENTIAL);
 
-unsigned int hashString(const char *s) {
-    unsigned long hash = 5381;
-    int c;
-    while ((c = (unsigned char)*s++))
-        hash = hash * 33 + c;
-    return hash % HASH_SIZE;
-}
+    const DqmCabecalho *cab = (const DqmCabecalho*) mapa;
+    int *ids = NULL;
+    int ok = 0;
 
-void inserirMapping(HashTable *ht, const char *pista, const char *suspeito) {
-    unsigned int idx = hashString(pista);
-    HashEntry *novo = malloc(sizeof(HashEntry));
+    uint64_t n = cab->nSalas, nt = cab->nTextos;
+    uint64_t inicioTextos = sizeof(DqmCabecalho) + n * sizeof(DqmSala) + nt * sizeof(uint32_t);
+    if (memcmp(cab->magica, DQM_MAGICA, 4) != 0 || cab->versao != DQM_VERSAO ||
+        n == 0 || n > INT32_MAX || inicioTextos > tam)
+        goto fim;
 
-    strncpy(novo->pista, pista, MAX_PISTA - 1);
-    novo->pista[MAX_PISTA - 1] = '\0';
+    const DqmSala *reg = (const DqmSala*) (mapa + sizeof(DqmCabecalho));
+    const uint32_t *offsets = (const uint32_t*) (reg + n);
+    const char *textos = (const char*) (mapa + inicioTextos);
+    size_t tamTextos = tam - inicioTextos;
 
-    strncpy(novo->suspeito, suspeito, MAX_NOME - 1);
-    novo->suspeito[MAX_NOME - 1] = '\0';
+    /* o último texto precisa terminar dentro do arquivo */
+    if (nt > 0 && (tamTextos == 0 || textos[tamTextos - 1] != '\0'))
+        goto fim;
 
-    novo->prox = ht->buckets[idx];
-    ht->buckets[idx] = novo;
-}
+    ids = malloc((nt ? nt : 1) * sizeof(int));
+    if (!ids) exit(1);
+    for (uint64_t t = 0; t < nt; t++) {
+        if (offsets[t] >= tamTextos) goto fim;
+        ids[t] = internar(textos + offsets[t]);
+    }
 
-const char* buscarSuspeitoPorPista(HashTable *ht, const char *pista) {
-    unsigned int idx = hashString(pista);
-    HashEntry *e = ht->buckets[idx];
-    while (e) {
-        if (strcmp(e->pista, pista) == 0)
-            return e->suspeito;
-        e = e->prox;
+    MansaoPlana tmp;
+    alocarMansaoPlana(a, &tmp, (int) n);
+    for (uint64_t i = 0; i < n; i++) {
+        const DqmSala *r = &reg[i];
+        if (r->nome < 0 || (uint64_t) r->nome >= nt ||
+            r->pista < -1 || r->pista >= (int64_t) nt ||
+            r->esq < -1 || r->esq >= (int64_t) n ||
+            r->dir < -1 || r->dir >= (int64_t) n)
+            goto fim;
+
+        tmp.salas[i].esq = r->esq;
+        tmp.salas[i].dir = r->dir;
+        tmp.salas[i].pista = r->pista == -1 ? SEM_PISTA : ids[r->pista];
+        tmp.nomes[i] = ids[r->nome];
     }
-    return NULL;
+    *m = tmp;
+    ok = 1;
+
+fim:
+    free(ids);
+    munmap((void*) mapa, tam);
+    return ok ? 0 : -1;
 }
 
-void liberarHash(HashTable *ht) {
-    for (int i = 0; i < HASH_SIZE; i++) {
-        HashEntry *e = ht->buckets[i];
-        while (e) {
-            HashEntry *next = e->prox;
-            free(e);
-            e = next;
+/* Grava a mansão plana no formato .dqm. Retorna 0 se deu certo. */
+int salvarMansao(const MansaoPlana *m, const char *caminho) {
+    DqmSala *reg = malloc((m->n ? m->n : 1) * sizeof(DqmSala));
+    int *indiceTexto = malloc((internos.total ? internos.total : 1) * sizeof(int));
+    int *textosUsados = malloc((internos.total ? internos.total : 1) * sizeof(int));
+    if (!reg || !indiceTexto || !textosUsados) exit(1);
+    for (int i = 0; i < internos.total; i++) indiceTexto[i] = -1;
+
+    /* id internado -> índice no arquivo, só para os textos usados */
+    int nt = 0;
+    for (int i = 0; i < m->n; i++) {
+        int ids[2] = { m->nomes[i], m->salas[i].pista };
+        for (int j = 0; j < 2; j++) {
+            if (ids[j] == SEM_PISTA || indiceTexto[ids[j]] != -1) continue;
+            indiceTexto[ids[j]] = nt;
+            textosUsados[nt++] = ids[j];
+        }
+        reg[i].esq = m->salas[i].esq;
+        reg[i].dir = m->salas[i].dir;
+        reg[i].nome = indiceTexto[m->nomes[i]];
+        reg[i].pista = m->salas[i].pista == SEM_PISTA ? -1 : indiceTexto[m->salas[i].pista];
+    }
+
+    FILE *f = fopen(caminho, "wb");
+    int erro = !f;
+    if (f) {
+        DqmCabecalho cab;
+        memcpy(cab.magica, DQM_MAGICA, 4);
+        cab.versao = DQM_VERSAO;
+        cab.nSalas = m->n;
+        cab.nTextos = nt;
+        fwrite(&cab, sizeof(cab), 1, f);
+        fwrite(reg, sizeof(DqmSala), m->n, f);
+
+        uint32_t off = 0;
+        for (int t = 0; t < nt; t++) {
+            fwrite(&off, sizeof(off), 1, f);
+            off += comprimentoInterno(textosUsados[t]) + 1;
         }
+        for (int t = 0; t < nt; t++)
+            fwrite(textoInterno(textosUsados[t]), 1, comprimentoInterno(textosUsados[t]) + 1, f);
+        erro = ferror(f);
+        if (fclose(f) != 0) erro = 1;
     }
+
+    free(reg);
+    free(indiceTexto);
+    free(textosUsados);
+    return erro ? -1 : 0;
 }
 
 /* ==========================
-   ACUSAÇÃO
+   GRAFO DA MANSÃO
    ========================== */
 
-int contarPistasAssociadas(PistaNode *r, HashTable *ht, const char *suspeito) {
-    if (!r) return 0;
-    int c = contarPistasAssociadas(r->esq, ht, suspeito);
-    const char *s = buscarSuspeitoPorPista(ht, r->pista);
-    if (s && strcmp(s, suspeito) == 0) c++;
-    return c + contarPistasAssociadas(r->dir, ht, suspeito);
+/* Monta o CSR a partir de uma lista de arestas em O(n + m): conta as
+   saídas por sala, acumula e distribui. peso pode ser NULL. */
+void construirGrafo(GrafoMansao *g, int n, const int *orig, const int *dest, const int *peso, int m) {
+    g->n = n;
+    g->m = m;
+    g->inicio = calloc((size_t) n + 1, sizeof(int));
+    g->destino = malloc((m ? m : 1) * sizeof(int));
+    g->peso = NULL;
+    if (!g->inicio || !g->destino) exit(1);
+
+    int pesado = 0;
+    for (int e = 0; e < m; e++) {
+        g->inicio[orig[e] + 1]++;
+        if (peso && peso[e] != 1) pesado = 1;
+    }
+    if (pesado) {
+        g->peso = malloc(m * sizeof(int));
+        if (!g->peso) exit(1);
+    }
+    for (int v = 0; v < n; v++) g->inicio[v + 1] += g->inicio[v];
+
+    int *pos = malloc((n ? n : 1) * sizeof(int));
+    if (!pos) exit(1);
+    memcpy(pos, g->inicio, n * sizeof(int));
+    for (int e = 0; e < m; e++) {
+        int k = pos[orig[e]]++;
+        g->destino[k] = dest[e];
+        if (pesado) g->peso[k] = peso[e];
+    }
+    free(pos);
 }
 
-void fazerAcusacao(PistaNode *pistasColetadas, HashTable *ht) {
-    if (!pistasColetadas) {
-        printf("\nSem pistas coletadas.\n");
-        return;
+/* Grafo com os caminhos esquerda/direita da mansão e, se arqPassagens
+   não for NULL, as passagens extras do arquivo: linhas "origem destino
+   peso" com índices de sala e peso >= 1. Retorna 0 ou -1 (arquivo
+   ilegível ou com sala/peso fora da faixa). */
+int grafoDaMansao(GrafoMansao *g, const MansaoPlana *m, const char *arqPassagens) {
+    int cap = 2 * m->n + 16, ne = 0;
+    int *orig = malloc(cap * sizeof(int)), *dest = malloc(cap * sizeof(int));
+    int *peso = malloc(cap * sizeof(int));
+    if (!orig || !dest || !peso) exit(1);
+
+    for (int v = 0; v < m->n; v++) {
+        int filhos[2] = { m->salas[v].esq, m->salas[v].dir };
+        for (int j = 0; j < 2; j++) {
+            if (filhos[j] == -1) continue;
+            orig[ne] = v;
+            dest[ne] = filhos[j];
+            peso[ne++] = 1;
+        }
     }
 
-    int op;
-    char escolha[MAX_NOME];
+    int erro = 0;
+    if (arqPassagens) {
+        Leitor *l = malloc(sizeof(Leitor));
+        if (!l) exit(1);
+        l->f = fopen(arqPassagens, "rb");
+        l->pos = l->tam = 0;
+        erro = !l->f;
+        while (!erro) {
+            int o = lerInteiro(l);
+            if (o == OPCAO_FIM) break;
+            int d = lerInteiro(l), p = lerInteiro(l);
+            if (o < 0 || o >= m->n || d < 0 || d >= m->n || p < 1) {
+                erro = 1;
+                break;
+            }
+            if (ne == cap) {
+                cap *= 2;
+                orig = realloc(orig, cap * sizeof(int));
+                dest = realloc(dest, cap * sizeof(int));
+                peso = realloc(peso, cap * sizeof(int));
+                if (!orig || !dest || !peso) exit(1);
+            }
+            orig[ne] = o;
+            dest[ne] = d;
+            peso[ne++] = p;
+        }
+        if (l->f) fclose(l->f);
+        free(l);
+    }
 
-    printf("\nQuem você deseja acusar?\n");
-    printf("1 - Dr. Silva\n");
-    printf("2 - Maria\n");
-    printf("3 - Capitão Rocha\n");
-    printf("0 - Cancelar\n");
-    printf("Escolha: ");
+    if (!erro) construirGrafo(g, m->n, orig, dest, peso, ne);
+    free(orig);
+    free(dest);
+    free(peso);
+    return erro ? -1 : 0;
+}
 
-    scanf("%d", &op);
-    limparBuffer();
+/* Caminho mínimo de origem até a sala mais próxima que satisfaz alvo:
+   BFS se todas as passagens valem 1, senão Dijkstra com heap binário.
+   Escreve em rota as primeiras max salas do caminho (origem inclusive)
+   e devolve o nº total de salas dele, ou -1 se nenhum alvo é
+   alcançável. custo (opcional) recebe a soma dos pesos. */
+int rotaMaisCurta(const GrafoMansao *g, int origem, int (*alvo)(int sala, const void *ctx),
+                  const void *ctx, int *rota, int max, long long *custo) {
+    int *pai = malloc(g->n * sizeof(int));
+    long long *dist = malloc(g->n * sizeof(long long));
+    if (!pai || !dist) exit(1);
+    for (int v = 0; v < g->n; v++) {
+        pai[v] = -1;
+        dist[v] = LLONG_MAX;
+    }
+    pai[origem] = origem;
+    dist[origem] = 0;
+    int achado = -1;
 
-    if (op == 1) strcpy(escolha, "Dr. Silva");
-    else if (op == 2) strcpy(escolha, "Maria");
-    else if (op == 3) strcpy(escolha, "Capitão Rocha");
-    else return;
+    if (!g->peso) {
+        /* BFS: dist serve de marca; a fila reaproveita um vetor de n */
+        int *fila = malloc(g->n * sizeof(int));
+        if (!fila) exit(1);
+        int ini = 0, fim = 0;
+        fila[fim++] = origem;
+        while (ini < fim) {
+            int v = fila[ini++];
+            if (alvo(v, ctx)) { achado = v; break; }
+            for (int k = g->inicio[v]; k < g->inicio[v + 1]; k++) {
+                int w = g->destino[k];
+                if (dist[w] != LLONG_MAX) continue;
+                dist[w] = dist[v] + 1;
+                pai[w] = v;
+                fila[fim++] = w;
+            }
+        }
+        free(fila);
+    } else {
+        /* Dijkstra com remoção preguiçosa: entradas vencidas são puladas */
+        typedef struct { long long d; int v; } ItemHeap;
+        int capHeap = 64, tam = 0;
+        ItemHeap *heap = malloc(capHeap * sizeof(ItemHeap));
+        if (!heap) exit(1);
+        heap[tam++] = (ItemHeap) { 0, origem };
+        while (tam > 0) {
+            ItemHeap topo = heap[0];
+            ItemHeap ult = heap[--tam];
+            int i = 0;
+            while (2 * i + 1 < tam) {
+                int f = 2 * i + 1;
+                if (f + 1 < tam && heap[f + 1].d < heap[f].d) f++;
+                if (heap[f].d >= ult.d) break;
+                heap[i] = heap[f];
+                i = f;
+            }
+            if (tam > 0) heap[i] = ult;
 
-    int cont = contarPistasAssociadas(pistasColetadas, ht, escolha);
+            int v = topo.v;
+            if (topo.d > dist[v]) continue;
+            if (alvo(v, ctx)) { achado = v; break; }
+            for (int k = g->inicio[v]; k < g->inicio[v + 1]; k++) {
+                int w = g->destino[k];
+                long long nd = dist[v] + g->peso[k];
+                if (nd >= dist[w]) continue;
+                dist[w] = nd;
+                pai[w] = v;
+                if (tam == capHeap) {
+                    capHeap *= 2;
+                    heap = realloc(heap, capHeap * sizeof(ItemHeap));
+                    if (!heap) exit(1);
+                }
+                int j = tam++;
+                while (j > 0 && heap[(j - 1) / 2].d > nd) {
+                    heap[j] = heap[(j - 1) / 2];
+                    j = (j - 1) / 2;
+                }
+                heap[j] = (ItemHeap) { nd, w };
+            }
+        }
+        free(heap);
+    }
 
-    printf("\nVocê acusou: %s\n", escolha);
-    printf("Pistas que apontam para ele: %d\n", cont);
+    int len = -1;
+    if (achado != -1) {
+        len = 1;
+        for (int v = achado; v != origem; v = pai[v]) len++;
+        int i = len - 1;
+        for (int v = achado; ; v = pai[v], i--) {
+            if (i < max) rota[i] = v;
+            if (v == origem) break;
+        }
+        if (custo) *custo = dist[achado];
+    }
+    free(pai);
+    free(dist);
+    return len;
+}
 
-    if (cont >= 2)
-        printf(">>> ACUSAÇÃO CORRETA!\n");
-    else
-        printf(">>> ACUSAÇÃO FALSA.\n");
+void liberarGrafo(GrafoMansao *g) {
+    free(g->inicio);
+    free(g->destino);
+    free(g->peso);
+    g->inicio = g->destino = g->peso = NULL;
+    g->n = g->m = 0;
 }
 
 /* ==========================
-   EXPLORAR MANSÃO
+   BST DE PISTAS (AVL)
    ========================== */
 
-void explorar(Sala *a, HashTable *ht, PistaNode **pc) {
-    Sala *at = a;
-    int opc;
+/* Primeiros 8 bytes do texto em big-endian (completados com zeros):
+   comparar dois prefixos como inteiros dá a mesma ordem do strcmp. */
+uint64_t prefixoPista(int p) {
+    const unsigned char *s = (const unsigned char*) textoInterno(p);
+    size_t n = comprimentoInterno(p);
+    uint64_t k = 0;
+    for (size_t i = 0; i < 8; i++)
+        k = (k << 8) | (i < n ? s[i] : 0);
+    return k;
+}
 
-    while (1) {
-        printf("\nVocê está em: %s\n", at->nome);
-
-        if (strlen(at->pista) > 0) {
-            printf("Encontrou a pista: %s\n", at->pista);
-            if (!existePistaBST(*pc, at->pista)) {
-                *pc = inserirPistaBST(*pc, at->pista);
-                const char *sus = buscarSuspeitoPorPista(ht, at->pista);
-                if (sus) printf("Associada a: %s\n", sus);
-            }
-        }
+PistaNode* criarPistaNode(Arena *a, int p) {
+    PistaNode *no = arenaAlocar(a, sizeof(PistaNode));
+    ESTAT_SOMA(nosPistaCriados, 1);
+    no->pista = p;
+    no->prefixo = prefixoPista(p);
+    no->altura = 1;
+    no->esq = no->dir = NULL;
+    return no;
+}
 
-        if (strcmp(at->nome, "Saída") == 0 ||
-            (at->esq == NULL && at->dir == NULL)) {
+/* Ordem alfabética entre a pista a (de prefixo pa) e o nó. Ids iguais
+   ou prefixos diferentes decidem sem tocar nos textos; prefixos iguais
+   com ids diferentes implicam os dois textos com 8+ bytes em comum. */
+static int compararPistas(int a, uint64_t pa, const PistaNode *no) {
+    if (a == no->pista) return 0;
+    if (pa != no->prefixo) return pa < no->prefixo ? -1 : 1;
+    return strcmp(textoInterno(a) + 8, textoInterno(no->pista) + 8);
+}
 
-            printf("\n--- FIM DA EXPLORAÇÃO ---\n");
-            printf("Pistas coletadas:\n");
-            exibirPistasInOrder(*pc);
+int existePistaBST(PistaNode *raiz, int p) {
+    uint64_t pp = prefixoPista(p);
+    long comps = 0;
+    int achou = 0;
+    while (raiz) {
+        int cmp = compararPistas(p, pp, raiz);
+        comps++;
+        if (cmp == 0) { achou = 1; break; }
+        raiz = cmp < 0 ? raiz->esq : raiz->dir;
+    }
+    ESTAT_SOMA(buscasBST, 1);
+    ESTAT_SOMA(comparacoesBusca, comps);
+    return achou;
+}
 
-            fazerAcusacao(*pc, ht);
-            return;
-        }
+static int alturaAVL(PistaNode *n) {
+    return n ? n->altura : 0;
+}
+
+static void atualizarAltura(PistaNode *n) {
+    int he = alturaAVL(n->esq), hd = alturaAVL(n->dir);
+    n->altura = (he > hd ? he : hd) + 1;
+}
 
-        printf("\n1 - Ir para esquerda");
-        if (!at->esq) printf(" (sem saída)");
+static PistaNode* rotacionarDireita(PistaNode *y) {
+    PistaNode *x = y->esq;
+    y->esq = x->dir;
+    x->dir = y;
+    atualizarAltura(y);
+    atualizarAltura(x);
+    return x;
+}
 
-        printf("\n2 - Ir para direita");
-        if (!at->dir) printf(" (sem saída)");
+static PistaNode* rotacionarEsquerda(PistaNode *x) {
+    PistaNode *y = x->dir;
+    x->dir = y->esq;
+    y->esq = x;
+    atualizarAltura(x);
+    atualizarAltura(y);
+    return y;
+}
 
-        printf("\n3 - Sair\nEscolha: ");
-        scanf("%d", &opc);
-        limparBuffer();
+/* Recalcula a altura de n e aplica a rotação simples/dupla necessária. */
+static PistaNode* balancearAVL(PistaNode *n) {
+    atualizarAltura(n);
+    int fb = alturaAVL(n->esq) - alturaAVL(n->dir);
 
-        if (opc == 1 && at->esq) at = at->esq;
-        else if (opc == 2 && at->dir) at = at->dir;
-        else if (opc == 3) return;
-        else printf("Movimento inválido.\n");
+    if (fb > 1) {
+        if (alturaAVL(n->esq->esq) < alturaAVL(n->esq->dir))
+            n->esq = rotacionarEsquerda(n->esq);
+        return rotacionarDireita(n);
     }
+    if (fb < -1) {
+        if (alturaAVL(n->dir->dir) < alturaAVL(n->dir->esq))
+            n->dir = rotacionarDireita(n->dir);
+        return rotacionarEsquerda(n);
+    }
+    return n;
 }
 
-void limparBuffer(void) {
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF);
-}
+static PistaNode* inserirAVL(Arena *a, PistaNode *raiz, int p, uint64_t pp, int *nova) {
+    if (!raiz) {
+        *nova = 1;
+        return criarPistaNode(a, p);
+    }
+    int cmp = compararPistas(p, pp, raiz);
+    ESTAT_SOMA(comparacoesInsercao, 1);
+    if (cmp == 0) return raiz;   /* já existe: nada muda no caminho */
 
-/* ==========================
-   MAIN
-   ========================== */
+    if (cmp < 0) raiz->esq = inserirAVL(a, raiz->esq, p, pp, nova);
+    else raiz->dir = inserirAVL(a, raiz->dir, p, pp, nova);
 
-int main(void) {
-    HashTable ht;
-    inicializarHash(&ht);
+    return *nova ? balancearAVL(raiz) : raiz;
+}
 
-    inserirMapping(&ht, "Frasco quebrado", "Dr. Silva");
-    inserirMapping(&ht, "Luvas manchadas", "Dr. Silva");
+/* Insere a pista se ainda não existir, numa única descida.
+   Retorna 1 se a pista é nova e 0 se já estava na árvore. */
+int inserirOuEncontrar(Arena *a, PistaNode **raiz, int p) {
+    int nova = 0;
+    *raiz = inserirAVL(a, *raiz, p, prefixoPista(p), &nova);
+    ESTAT_SOMA(insercoesBST, 1);
+    ESTAT_MAX(maxAlturaBST, (*raiz)->altura);
+    return nova;
+}
 
-    inserirMapping(&ht, "Fio de cabelo loiro", "Maria");
-    inserirMapping(&ht, "Carta rasgada", "Maria");
-    inserirMapping(&ht, "Mapa rasgado", "Maria");
+PistaNode* inserirPistaBST(Arena *a, PistaNode *raiz, int p) {
+    inserirOuEncontrar(a, &raiz, p);
+    return raiz;
+}
 
-    inserirMapping(&ht, "Pegadas de botas", "Capitão Rocha");
-    inserirMapping(&ht, "Chave enferrujada", "Capitão Rocha");
+static PistaNode* copiarPistaNode(Arena *a, const PistaNode *n) {
+    PistaNode *c = arenaAlocar(a, sizeof(PistaNode));
+    ESTAT_SOMA(nosPistaCriados, 1);
+    *c = *n;
+    return c;
+}
 
-    inserirMapping(&ht, "Livro sobre mutacoes", "Dr. Silva");
+/* Como inserirAVL, mas copiando o caminho em vez de alterá-lo. As
+   rotações só mexem em nós do lado que cresceu, que são cópias deste
+   caminho, então a versão anterior continua intacta. Se a pista já
+   existe nada é copiado e a mesma raiz volta. */
+static PistaNode* inserirPersistenteAVL(Arena *a, PistaNode *raiz, int p, uint64_t pp, int *nova) {
+    if (!raiz) {
+        *nova = 1;
+        return criarPistaNode(a, p);
+    }
+    int cmp = compararPistas(p, pp, raiz);
+    ESTAT_SOMA(comparacoesInsercao, 1);
+    if (cmp == 0) return raiz;
 
-    Sala *mansao = montarMansao();
-    PistaNode *pistas = NULL;
+    PistaNode *filho = inserirPersistenteAVL(a, cmp < 0 ? raiz->esq : raiz->dir, p, pp, nova);
+    if (!*nova) return raiz;
 
-    int opc;
+    PistaNode *c = copiarPistaNode(a, raiz);
+    if (cmp < 0) c->esq = filho;
+    else c->dir = filho;
+    return balancearAVL(c);
+}
+
+/* inserirOuEncontrar persistente: *raiz passa a ser a nova versão e a
+   antiga continua válida. Custa O(log n) nós novos por pista nova. */
+int inserirPersistente(Arena *a, PistaNode **raiz, int p) {
+    int nova = 0;
+    *raiz = inserirPersistenteAVL(a, *raiz, p, prefixoPista(p), &nova);
+    ESTAT_SOMA(insercoesBST, 1);
+    ESTAT_MAX(maxAlturaBST, (*raiz)->altura);
+    return nova;
+}
+
+/* Empilha o nó e todo o seu ramo esquerdo. */
+static void descerEsquerda(CursorPistas *c, const PistaNode *no) {
+    for (; no; no = no->esq) {
+        if (c->topo == CURSOR_ALTURA_MAX) {
+            fprintf(stderr, "cursor: árvore de pistas alta demais\n");
+            exit(1);
+        }
+        c->pilha[c->topo++] = no;
+    }
+}
+
+void iniciarCursor(CursorPistas *c, const PistaNode *raiz) {
+    c->topo = 0;
+    descerEsquerda(c, raiz);
+}
+
+/* Id da próxima pista em ordem alfabética, ou -1 no fim. */
+int proximaPista(CursorPistas *c) {
+    if (c->topo == 0) return -1;
+    const PistaNode *no = c->pilha[--c->topo];
+    descerEsquerda(c, no->dir);
+    return no->pista;
+}
+
+/* Até max próximas pistas em saida; devolve quantas vieram. */
+int proximasPistas(CursorPistas *c, int *saida, int max) {
+    int n = 0;
+    while (n < max && c->topo > 0)
+        saida[n++] = proximaPista(c);
+    return n;
+}
+
+void exibirPistasInOrder(PistaNode *raiz) {
+    CursorPistas c;
+    iniciarCursor(&c, raiz);
+    for (int p; (p = proximaPista(&c)) != -1; )
+        printf(" - %s\n", textoInterno(p));
+}
+
+/* Consultas por faixa: só descem nas subárvores que podem conter
+   resultados, então custam O(log n + k). Os ids encontrados vão em
+   ordem alfabética para saida, até max; o retorno é quantos foram
+   escritos (max indica que pode haver mais).
+   A faixa vai de "de" até tudo que começa com "ate", inclusive: de "A"
+   até "F" inclui "Fio de cabelo loiro". NULL deixa o lado aberto. */
+
+typedef struct ConsultaFaixa {
+    const char *de, *ate;
+    size_t nAte;
+    int *saida;
+    int max, n;
+} ConsultaFaixa;
+
+/* < 0 se o nó vem antes da faixa, > 0 se vem depois e 0 se está nela. */
+static int posicaoNaFaixa(const ConsultaFaixa *q, const PistaNode *no) {
+    const char *t = textoInterno(no->pista);
+    if (q->de && strcmp(t, q->de) < 0) return -1;
+    return q->ate && strncmp(t, q->ate, q->nAte) > 0;
+}
+
+static void coletarFaixa(ConsultaFaixa *q, const PistaNode *no) {
+    while (no && q->n < q->max) {
+        int pos = posicaoNaFaixa(q, no);
+        if (pos < 0) { no = no->dir; continue; }
+        if (pos > 0) { no = no->esq; continue; }
+        coletarFaixa(q, no->esq);
+        if (q->n < q->max) q->saida[q->n++] = no->pista;
+        no = no->dir;
+    }
+}
+
+int buscarPistasIntervalo(PistaNode *raiz, const char *de, const char *ate, int *saida, int max) {
+    ConsultaFaixa q = { de, ate, ate ? strlen(ate) : 0, saida, max, 0 };
+    coletarFaixa(&q, raiz);
+    return q.n;
+}
+
+/* Pistas que começam com prefixo: a faixa de prefixo até prefixo. */
+int buscarPistasPrefixo(PistaNode *raiz, const char *prefixo, int *saida, int max) {
+    return buscarPistasIntervalo(raiz, prefixo, prefixo, saida, max);
+}
+
+/* ==========================
+   INVESTIGAÇÃO
+   ========================== */
+
+void inicializarInvestigacao(Investigacao *inv) {
+    inv->pistas = NULL;
+    inv->nos = NULL;
+    inv->historico = NULL;
+    inv->coletadas = NULL;
+    inv->palavrasColetadas = 0;
+    inv->placar.contagem = inv->placar.posHeap = inv->placar.heap = NULL;
+    inv->placar.tamHeap = inv->placar.cap = 0;
+    inv->salaAtual = 0;
+    inv->retomarEm = -1;
+    inv->acusado = -1;
+    inv->acertou = 0;
+}
+
+/* Libera a BST de pistas de uma vez, junto com a arena, a menos que
+   outro ramo ainda a use. */
+void liberarInvestigacao(Investigacao *inv) {
+    if (inv->nos && --inv->nos->refs == 0) {
+        liberarArena(&inv->nos->arena);
+        free(inv->nos);
+    }
+    free(inv->placar.contagem);
+    free(inv->placar.posHeap);
+    free(inv->placar.heap);
+    free(inv->coletadas);
+    inicializarInvestigacao(inv);
+}
+
+Arena* arenaDaInvestigacao(Investigacao *inv) {
+    if (!inv->nos) {
+        inv->nos = malloc(sizeof(ArenaRamos));
+        if (!inv->nos) exit(1);
+        inicializarArena(&inv->nos->arena);
+        inv->nos->refs = 1;
+    }
+    return &inv->nos->arena;
+}
+
+static void* copiarBytes(const void *v, size_t n) {
+    if (n == 0) return NULL;
+    void *c = malloc(n);
+    if (!c) exit(1);
+    memcpy(c, v, n);
+    return c;
+}
+
+/* Abre em ramo uma cópia de origem no ponto em que ela está. A BST e o
+   histórico são divididos, não copiados: O(1). O placar e o conjunto de
+   coletadas são mutáveis e saem copiados, O(s + p/64). Daí em diante
+   cada um segue sozinho; ramo deve ser liberado com liberarInvestigacao. */
+void ramificarInvestigacao(Investigacao *ramo, const Investigacao *origem) {
+    size_t cap = origem->placar.cap * sizeof(int);
+    *ramo = *origem;
+    if (ramo->nos) ramo->nos->refs++;
+    ramo->placar.contagem = copiarBytes(origem->placar.contagem, cap);
+    ramo->placar.posHeap = copiarBytes(origem->placar.posHeap, cap);
+    ramo->placar.heap = copiarBytes(origem->placar.heap, cap);
+    ramo->coletadas = copiarBytes(origem->coletadas, origem->palavrasColetadas * sizeof(uint64_t));
+}
+
+/* O conjunto de coletadas é a fonte das evidências; o placar é derivado
+   dele e só muda aqui, quando um bit de fato liga ou desliga. */
+static void marcarColetada(Investigacao *inv, int e, int suspeito) {
+    int w = e / 64;
+    if (w >= inv->palavrasColetadas) {
+        int nova = inv->palavrasColetadas ? inv->palavrasColetadas : 1;
+        while (nova <= w) nova *= 2;
+        inv->coletadas = realloc(inv->coletadas, nova * sizeof(uint64_t));
+        if (!inv->coletadas) exit(1);
+        memset(inv->coletadas + inv->palavrasColetadas, 0,
+               (nova - inv->palavrasColetadas) * sizeof(uint64_t));
+        inv->palavrasColetadas = nova;
+    }
+    if (inv->coletadas[w] >> (e % 64) & 1) return;
+    inv->coletadas[w] |= 1ULL << (e % 64);
+    registrarEvidencia(&inv->placar, suspeito);
+}
+
+static void desmarcarColetada(Investigacao *inv, int e, int suspeito) {
+    if (e / 64 >= inv->palavrasColetadas || !(inv->coletadas[e / 64] >> (e % 64) & 1)) return;
+    inv->coletadas[e / 64] &= ~(1ULL << (e % 64));
+    retirarEvidencia(&inv->placar, suspeito);
+}
+
+/* ==========================
+   PLACAR DE SUSPEITOS
+   ========================== */
+
+/* a vem antes de b no heap: mais evidências, e no empate o menor id. */
+static int precedeNoPlacar(const Placar *p, int a, int b) {
+    if (p->contagem[a] != p->contagem[b])
+        return p->contagem[a] > p->contagem[b];
+    return a < b;
+}
+
+static void garantirCapPlacar(Placar *p, int id) {
+    if (id < p->cap) return;
+    int novaCap = p->cap ? p->cap : 8;
+    while (novaCap <= id) novaCap *= 2;
+
+    p->contagem = realloc(p->contagem, novaCap * sizeof(int));
+    p->posHeap = realloc(p->posHeap, novaCap * sizeof(int));
+    p->heap = realloc(p->heap, novaCap * sizeof(int));
+    if (!p->contagem || !p->posHeap || !p->heap) exit(1);
+
+    for (int i = p->cap; i < novaCap; i++) {
+        p->contagem[i] = 0;
+        p->posHeap[i] = -1;
+    }
+    p->cap = novaCap;
+}
+
+/* Soma uma evidência contra o suspeito e sobe-o no heap: O(log s). */
+void registrarEvidencia(Placar *p, int suspeito) {
+    garantirCapPlacar(p, suspeito);
+    p->contagem[suspeito]++;
+
+    int i = p->posHeap[suspeito];
+    if (i == -1) i = p->tamHeap++;
+
+    while (i > 0) {
+        int pai = (i - 1) / 2;
+        if (!precedeNoPlacar(p, suspeito, p->heap[pai])) break;
+        p->heap[i] = p->heap[pai];
+        p->posHeap[p->heap[i]] = i;
+        i = pai;
+    }
+    p->heap[i] = suspeito;
+    p->posHeap[suspeito] = i;
+}
+
+/* Desfaz um registrarEvidencia: O(log s). Quem chega a zero sai do heap,
+   e o último elemento ocupa o lugar dele. */
+void retirarEvidencia(Placar *p, int suspeito) {
+    if (suspeito < 0 || suspeito >= p->cap || p->contagem[suspeito] == 0) return;
+    p->contagem[suspeito]--;
+
+    int i = p->posHeap[suspeito];
+    if (p->contagem[suspeito] == 0) {
+        p->posHeap[suspeito] = -1;
+        suspeito = p->heap[--p->tamHeap];
+        if (i == p->tamHeap) return;
+    }
+
+    while (i > 0 && precedeNoPlacar(p, suspeito, p->heap[(i - 1) / 2])) {
+        p->heap[i] = p->heap[(i - 1) / 2];
+        p->posHeap[p->heap[i]] = i;
+        i = (i - 1) / 2;
+    }
+    while (1) {
+        int f = 2 * i + 1;
+        if (f >= p->tamHeap) break;
+        if (f + 1 < p->tamHeap && precedeNoPlacar(p, p->heap[f + 1], p->heap[f])) f++;
+        if (!precedeNoPlacar(p, p->heap[f], suspeito)) break;
+        p->heap[i] = p->heap[f];
+        p->posHeap[p->heap[i]] = i;
+        i = f;
+    }
+    p->heap[i] = suspeito;
+    p->posHeap[suspeito] = i;
+}
+
+int evidenciasContra(const Placar *p, int suspeito) {
+    if (suspeito < 0 || suspeito >= p->cap) return 0;
+    return p->contagem[suspeito];
+}
+
+/* Copia em saida os k suspeitos com mais evidências, em ordem.
+   Percorre o heap com uma fila de prioridade auxiliar de posições,
+   então custa O(k log k) sem alterar o placar. Retorna quantos achou. */
+int topSuspeitos(const Placar *p, int k, int *saida) {
+    if (k <= 0 || p->tamHeap == 0) return 0;
+
+    int *cand = malloc((2 * k + 1) * sizeof(int));
+    if (!cand) exit(1);
+    int nCand = 0, n = 0;
+    cand[nCand++] = 0;
+
+    while (n < k && nCand > 0) {
+        int topo = cand[0];
+        saida[n++] = p->heap[topo];
+
+        /* remove a raiz da fila auxiliar */
+        int ultimo = cand[--nCand];
+        int i = 0;
+        while (nCand > 0) {
+            int f = 2 * i + 1;
+            if (f >= nCand) break;
+            if (f + 1 < nCand && precedeNoPlacar(p, p->heap[cand[f + 1]], p->heap[cand[f]])) f++;
+            if (!precedeNoPlacar(p, p->heap[cand[f]], p->heap[ultimo])) break;
+            cand[i] = cand[f];
+            i = f;
+        }
+        if (nCand > 0) cand[i] = ultimo;
+
+        /* os filhos de topo no heap viram candidatos */
+        for (int f = 2 * topo + 1; f <= 2 * topo + 2 && f < p->tamHeap; f++) {
+            int j = nCand++;
+            while (j > 0 && precedeNoPlacar(p, p->heap[f], p->heap[cand[(j - 1) / 2]])) {
+                cand[j] = cand[(j - 1) / 2];
+                j = (j - 1) / 2;
+            }
+            cand[j] = f;
+        }
+    }
+
+    free(cand);
+    return n;
+}
+
+void exibirSuspeitosProvaveis(const Placar *p, int k) {
+    int top[8];
+    if (k > 8) k = 8;
+    int n = topSuspeitos(p, k, top);
+    if (n == 0) {
+        printf("\nNenhuma pista aponta para suspeitos ainda.\n");
+        return;
+    }
+    printf("\nSuspeitos mais prováveis:\n");
+    for (int i = 0; i < n; i++)
+        printf(" %d. %s (%d pista%s)\n", i + 1, textoInterno(top[i]),
+               p->contagem[top[i]], p->contagem[top[i]] == 1 ? "" : "s");
+}
+
+/* ==========================
+   HASH TABLE
+   ========================== */
+
+void inicializarHash(HashTable *ht) {
+    ht->tamanho = 0;
+    ht->capEntradas = HASH_CAP_INICIAL;
+    ht->entradas = malloc(ht->capEntradas * sizeof(HashEntry));
+    if (!ht->entradas) exit(1);
+    ht->capacidade = HASH_CAP_INICIAL;
+    ht->slots = alocarSlots(ht->capacidade);
+    ht->primeiraPista = ht->suspeitos = ht->indiceSuspeito = NULL;
+    ht->capSuspeitos = ht->nSuspeitos = 0;
+    ht->evidencias = NULL;
+    ht->capLinhas = 0;
+    ht->usaCatalogo = ht->catalogoSobreposto = 0;
+}
+
+/* Hash de 64 bits lendo 8 bytes por vez (memcpy: sem exigir
+   alinhamento); o resto entra num último bloco junto com o comprimento. */
+uint64_t hashBytes(const char *s, size_t n) {
+    const uint64_t k1 = 0x9e3779b97f4a7c15ULL, k2 = 0xbf58476d1ce4e5b9ULL;
+    uint64_t h = n * k1;
+    uint64_t w;
+
+    for (; n >= 8; s += 8, n -= 8) {
+        memcpy(&w, s, 8);
+        w *= k2;
+        h = (h ^ (w ^ (w >> 31))) * k1;
+        h = (h << 27) | (h >> 37);
+    }
+    if (n > 0) {
+        w = 0;
+        memcpy(&w, s, n);
+        w *= k2;
+        h = (h ^ (w ^ (w >> 31))) * k1;
+    }
+    /* mistura final: as tabelas usam os bits baixos como índice */
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t hashString(const char *s) {
+    return hashBytes(s, strlen(s));
+}
+
+/* Espalha um id inteiro pelos 32 bits (os ids são sequenciais). */
+static unsigned int hashId(int id) {
+    unsigned int x = (unsigned int) id;
+    x ^= x >> 16;
+    x *= 0x45d9f3bU;
+    x ^= x >> 16;
+    return x;
+}
+
+/* Devolve o slot da pista (ocupado) ou o slot vazio onde ela entraria. */
+static int localizarSlot(const HashTable *ht, int pista, unsigned int h) {
+    unsigned int mask = ht->capacidade - 1;
+    unsigned int i = h & mask;
+    long sond = 0;
+    while (ht->slots[i].indice != -1 && ht->entradas[ht->slots[i].indice].pista != pista) {
+        i = (i + 1) & mask;
+        sond++;
+    }
+    ESTAT_SONDAGEM(pistas, sond);
+    return i;
+}
+
+/* Garante primeiraPista[suspeito]; registra o suspeito na 1ª vez. */
+static void registrarSuspeito(HashTable *ht, int suspeito) {
+    if (suspeito >= ht->capSuspeitos) {
+        int novaCap = ht->capSuspeitos ? ht->capSuspeitos : 8;
+        while (novaCap <= suspeito) novaCap *= 2;
+        ht->primeiraPista = realloc(ht->primeiraPista, novaCap * sizeof(int));
+        ht->suspeitos = realloc(ht->suspeitos, novaCap * sizeof(int));
+        ht->indiceSuspeito = realloc(ht->indiceSuspeito, novaCap * sizeof(int));
+        if (!ht->primeiraPista || !ht->suspeitos || !ht->indiceSuspeito) exit(1);
+        for (int i = ht->capSuspeitos; i < novaCap; i++) {
+            ht->primeiraPista[i] = SUSPEITO_AUSENTE;
+            ht->indiceSuspeito[i] = -1;
+        }
+        ht->capSuspeitos = novaCap;
+    }
+    if (ht->primeiraPista[suspeito] == SUSPEITO_AUSENTE) {
+        if (ht->nSuspeitos == ht->capLinhas) {
+            ht->capLinhas = ht->capLinhas ? ht->capLinhas * 2 : 8;
+            ht->evidencias = realloc(ht->evidencias, ht->capLinhas * sizeof(LinhaEvidencias));
+            if (!ht->evidencias) exit(1);
+        }
+        ht->evidencias[ht->nSuspeitos].p = NULL;
+        ht->evidencias[ht->nSuspeitos].n = ht->evidencias[ht->nSuspeitos].cap = 0;
+        ht->primeiraPista[suspeito] = -1;
+        ht->indiceSuspeito[suspeito] = ht->nSuspeitos;
+        ht->suspeitos[ht->nSuspeitos++] = suspeito;
+    }
+}
+
+/* 1ª posição da linha com palavra >= w. */
+static int buscarPalavra(const LinhaEvidencias *l, int w) {
+    int ini = 0, fim = l->n;
+    while (ini < fim) {
+        int meio = (ini + fim) / 2;
+        if (l->p[meio].palavra < w) ini = meio + 1;
+        else fim = meio;
+    }
+    return ini;
+}
+
+/* Liga o bit da entrada e na linha do suspeito. Entradas novas têm o
+   maior índice até aqui, então o caso comum é anexar ou mexer na
+   última palavra; só um remapeamento insere no meio. */
+static void ligarEvidencia(HashTable *ht, int suspeito, int e) {
+    LinhaEvidencias *l = &ht->evidencias[ht->indiceSuspeito[suspeito]];
+    int w = e / 64;
+    int i = l->n && l->p[l->n - 1].palavra < w ? l->n : buscarPalavra(l, w);
+    if (i == l->n || l->p[i].palavra != w) {
+        if (l->n == l->cap) {
+            l->cap = l->cap ? l->cap * 2 : 2;
+            l->p = realloc(l->p, l->cap * sizeof(PalavraEvidencia));
+            if (!l->p) exit(1);
+        }
+        memmove(l->p + i + 1, l->p + i, (l->n - i) * sizeof(PalavraEvidencia));
+        l->p[i].palavra = w;
+        l->p[i].bits = 0;
+        l->n++;
+    }
+    l->p[i].bits |= 1ULL << (e % 64);
+}
+
+/* Desliga o bit; a palavra sai da linha quando zera. */
+static void desligarEvidencia(HashTable *ht, int suspeito, int e) {
+    LinhaEvidencias *l = &ht->evidencias[ht->indiceSuspeito[suspeito]];
+    int i = buscarPalavra(l, e / 64);
+    if (i == l->n || l->p[i].palavra != e / 64) return;
+    l->p[i].bits &= ~(1ULL << (e % 64));
+    if (l->p[i].bits == 0) {
+        l->n--;
+        memmove(l->p + i, l->p + i + 1, (l->n - i) * sizeof(PalavraEvidencia));
+    }
+}
+
+/* Põe a entrada e no fim da lista circular do seu suspeito. */
+static void encadearEntrada(HashTable *ht, int e) {
+    HashEntry *en = ht->entradas;
+    int s = en[e].suspeito;
+    registrarSuspeito(ht, s);
+    ligarEvidencia(ht, s, e);
+    int cab = ht->primeiraPista[s];
+    if (cab == -1) {
+        en[e].ant = en[e].prox = e;
+        ht->primeiraPista[s] = e;
+    } else {
+        int ult = en[cab].ant;
+        en[e].ant = ult;
+        en[e].prox = cab;
+        en[ult].prox = e;
+        en[cab].ant = e;
+    }
+}
+
+static void desencadearEntrada(HashTable *ht, int e) {
+    HashEntry *en = ht->entradas;
+    int s = en[e].suspeito;
+    desligarEvidencia(ht, s, e);
+    if (en[e].prox == e) {
+        ht->primeiraPista[s] = -1;
+        return;
+    }
+    en[en[e].ant].prox = en[e].prox;
+    en[en[e].prox].ant = en[e].ant;
+    if (ht->primeiraPista[s] == e) ht->primeiraPista[s] = en[e].prox;
+}
+
+void inserirMapping(HashTable *ht, const char *pista, const char *suspeito) {
+    size_t n = strlen(pista);
+    uint64_t hp = hashBytes(pista, n);
+    if (ht->usaCatalogo && !ht->catalogoSobreposto) {
+        const char *fixo = buscarSuspeitoCatalogo(pista, n, hp);
+        if (fixo && strcmp(fixo, suspeito) != 0) ht->catalogoSobreposto = 1;
+    }
+
+    int idPista = internarComHash(pista, n, hp);
+    int idSuspeito = internar(suspeito);
+    unsigned int h = hashId(idPista);
+    int i = localizarSlot(ht, idPista, h);
+    int e;
+
+    if (ht->slots[i].indice != -1) {
+        /* pista já mapeada: o mapeamento mais recente prevalece e a
+           entrada muda de lista se o suspeito for outro */
+        e = ht->slots[i].indice;
+        if (ht->entradas[e].suspeito == idSuspeito) return;
+        desencadearEntrada(ht, e);
+    } else {
+        /* fator de carga máximo de 3/4 */
+        if ((ht->tamanho + 1) * 4 > ht->capacidade * 3) {
+            ht->slots = dobrarSlots(ht->slots, &ht->capacidade);
+            i = localizarSlot(ht, idPista, h);
+        }
+        if (ht->tamanho == ht->capEntradas) {
+            ht->capEntradas *= 2;
+            ht->entradas = realloc(ht->entradas, ht->capEntradas * sizeof(HashEntry));
+            if (!ht->entradas) exit(1);
+        }
+        ESTAT_SOMA(entradasCriadas, 1);
+        ht->slots[i].hash = h;
+        ht->slots[i].indice = ht->tamanho;
+        e = ht->tamanho++;
+        ht->entradas[e].pista = idPista;
+    }
+
+    ht->entradas[e].suspeito = idSuspeito;
+    encadearEntrada(ht, e);
+}
+
+/* Entrada (id denso da pista no catálogo) da pista (id), ou -1. */
+int buscarEntradaPista(const HashTable *ht, int pista) {
+    return ht->slots[localizarSlot(ht, pista, hashId(pista))].indice;
+}
+
+/* Suspeito (id) associado à pista (id), ou -1. */
+int buscarSuspeitoId(HashTable *ht, int pista) {
+    int e = buscarEntradaPista(ht, pista);
+    return e == -1 ? -1 : ht->entradas[e].suspeito;
+}
+
+/* Se a tabela carregou o catálogo estático, ele responde primeiro; a
+   tabela dinâmica fica para as pistas mapeadas em tempo de execução (e
+   para todas, se alguma do catálogo foi remapeada). */
+const char* buscarSuspeitoPorPista(HashTable *ht, const char *pista) {
+    ESTAT_SOMA(buscasSuspeito, 1);
+    size_t n = strlen(pista);
+    uint64_t h = hashBytes(pista, n);
+    if (ht->usaCatalogo && !ht->catalogoSobreposto) {
+        const char *fixo = buscarSuspeitoCatalogo(pista, n, h);
+        if (fixo) return fixo;
+    }
+
+    int id = internos.slots[localizarInterno(pista, n, h)].indice;
+    if (id == -1) return NULL;
+    int sus = buscarSuspeitoId(ht, id);
+    return sus == -1 ? NULL : textoInterno(sus);
+}
+
+/* Pistas (ids) do catálogo que apontam para o suspeito, na ordem em
+   que foram mapeadas, até max. Custa O(k): só percorre a lista dele. */
+int listarPistasDoSuspeito(const HashTable *ht, int suspeito, int *saida, int max) {
+    if (suspeito < 0 || suspeito >= ht->capSuspeitos) return 0;
+    int cab = ht->primeiraPista[suspeito];
+    if (cab < 0) return 0;
+
+    int n = 0, e = cab;
+    do {
+        if (n == max) break;
+        saida[n++] = ht->entradas[e].pista;
+        e = ht->entradas[e].prox;
+    } while (e != cab);
+    return n;
+}
+
+/* Todos os suspeitos e suas pistas, numa passada por suspeito/entrada. */
+void listarAssociacoes(const HashTable *ht) {
+    printf("\nSuspeitos e pistas associadas:\n");
+    for (int i = 0; i < ht->nSuspeitos; i++) {
+        int s = ht->suspeitos[i];
+        int cab = ht->primeiraPista[s];
+        if (cab < 0) continue;   /* perdeu todas as pistas num remapeamento */
+
+        printf("%s:\n", textoInterno(s));
+        int e = cab;
+        do {
+            printf("  - %s\n", textoInterno(ht->entradas[e].pista));
+            e = ht->entradas[e].prox;
+        } while (e != cab);
+    }
+}
+
+void liberarHash(HashTable *ht) {
+    free(ht->entradas);
+    free(ht->slots);
+    free(ht->primeiraPista);
+    free(ht->suspeitos);
+    free(ht->indiceSuspeito);
+    for (int i = 0; i < ht->nSuspeitos; i++) free(ht->evidencias[i].p);
+    free(ht->evidencias);
+    ht->evidencias = NULL;
+    ht->capLinhas = 0;
+    ht->entradas = NULL;
+    ht->slots = NULL;
+    ht->primeiraPista = ht->suspeitos = ht->indiceSuspeito = NULL;
+    ht->tamanho = ht->capEntradas = ht->capacidade = 0;
+    ht->capSuspeitos = ht->nSuspeitos = 0;
+    ht->usaCatalogo = ht->catalogoSobreposto = 0;
+}
+
+/* ==========================
+   CATÁLOGO ESTÁTICO
+   ========================== */
+
+/* Segundo hash da CHD: espalha h conforme o deslocamento do balde. */
+static uint64_t misturarHash(uint64_t h, uint32_t d) {
+    h ^= (uint64_t) d * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* Suspeito da pista no catálogo estático, ou NULL. h = hashBytes(pista, n). */
+const char* buscarSuspeitoCatalogo(const char *pista, size_t n, uint64_t h) {
+    uint32_t d = CATALOGO_DESLOC[(h >> 32) % CATALOGO_BALDES];
+    const CatalogoPista *c = &CATALOGO_PISTAS[misturarHash(h, d) % CATALOGO_SLOTS];
+    if (c->pista && c->comprimento == n && memcmp(c->pista, pista, n) == 0)
+        return c->suspeito;
+    return NULL;
+}
+
+/* Copia o catálogo para a tabela dinâmica, na ordem do arquivo: o jogo
+   consulta por id internado (salas, placar, índice reverso). */
+void carregarCatalogoEstatico(HashTable *ht) {
+    ht->usaCatalogo = 1;
+    for (int i = 0; i < CATALOGO_N; i++) {
+        const CatalogoPista *c = &CATALOGO_PISTAS[CATALOGO_ORDEM[i]];
+        inserirMapping(ht, c->pista, c->suspeito);
+    }
+    if (hashBytes("catalogo", 8) != CATALOGO_HASH_TESTE) {
+        /* hashBytes mudou desde a geração: a tabela perfeita não acha
+           mais nada, então as buscas vão direto para a dinâmica */
+        fprintf(stderr, "catalogo_pistas.h desatualizado; gere-o de novo\n");
+        ht->catalogoSobreposto = 1;
+    }
+}
+
+#define CHD_LAMBDA 4              /* chaves por balde, em média */
+#define CHD_MAX_DESLOC (1u << 20) /* tentativas por balde antes de crescer */
+
+static void escreverLiteralC(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') fputc('\\', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static int compararBaldesPorTamanho(const void *a, const void *b, void *tam) {
+    const int *t = tam;
+    return t[*(const int*) b] - t[*(const int*) a];
+}
+
+/* Ordena linhas do catálogo por (hash, nº da linha). */
+static int compararLinhasPorHash(const void *a, const void *b, void *hashes) {
+    const uint64_t *h = hashes;
+    int i = *(const int*) a, j = *(const int*) b;
+    if (h[i] != h[j]) return h[i] < h[j] ? -1 : 1;
+    return i - j;
+}
+
+/* Lê um catálogo "pista;suspeito" por linha (# comenta, linhas vazias
+   são ignoradas, a última ocorrência de uma pista prevalece) e escreve
+   em saida o cabeçalho C com a tabela perfeita. Retorna 0 se deu certo. */
+int gerarHashPerfeita(const char *caminho, FILE *saida) {
+    FILE *f = fopen(caminho, "r");
+    if (!f) {
+        fprintf(stderr, "Erro ao abrir o catálogo %s\n", caminho);
+        return 1;
+    }
+
+    int n = 0, cap = 16;
+    char **pistas = malloc(cap * sizeof(char*)), **suspeitos = malloc(cap * sizeof(char*));
+    uint64_t *hashes = malloc(cap * sizeof(uint64_t));
+    if (!pistas || !suspeitos || !hashes) exit(1);
+
+    char linha[512];
+    int numLinha = 0, erro = 0;
+    while (!erro && fgets(linha, sizeof linha, f)) {
+        numLinha++;
+        linha[strcspn(linha, "\r\n")] = '\0';
+        if (linha[0] == '\0' || linha[0] == '#') continue;
+        char *sep = strchr(linha, ';');
+        if (!sep || sep == linha || sep[1] == '\0') {
+            fprintf(stderr, "%s:%d: esperado \"pista;suspeito\"\n", caminho, numLinha);
+            erro = 1;
+            break;
+        }
+        *sep = '\0';
+        if (n == cap) {
+            cap *= 2;
+            pistas = realloc(pistas, cap * sizeof(char*));
+            suspeitos = realloc(suspeitos, cap * sizeof(char*));
+            hashes = realloc(hashes, cap * sizeof(uint64_t));
+            if (!pistas || !suspeitos || !hashes) exit(1);
+        }
+        pistas[n] = strdup(linha);
+        suspeitos[n] = strdup(sep + 1);
+        hashes[n] = hashBytes(linha, strlen(linha));
+        if (!pistas[n] || !suspeitos[n]) exit(1);
+        n++;
+    }
+    fclose(f);
+
+    /* pistas repetidas ficam juntas ao ordenar por hash: a primeira
+       linha dá a posição e a última, o suspeito; hashes iguais com
+       textos diferentes inviabilizam a tabela */
+    int *perm = malloc((n ? n : 1) * sizeof(int));
+    char *descartar = calloc(n ? n : 1, 1);
+    if (!perm || !descartar) exit(1);
+    for (int i = 0; i < n; i++) perm[i] = i;
+    qsort_r(perm, n, sizeof(int), compararLinhasPorHash, hashes);
+    for (int a = 0, b; !erro && a < n; a = b) {
+        for (b = a + 1; b < n && hashes[perm[b]] == hashes[perm[a]]; b++) {
+            if (strcmp(pistas[perm[a]], pistas[perm[b]]) != 0) {
+                fprintf(stderr, "%s: \"%s\" e \"%s\" têm o mesmo hash\n", caminho,
+                        pistas[perm[a]], pistas[perm[b]]);
+                erro = 1;
+                break;
+            }
+            descartar[perm[b]] = 1;
+        }
+        if (!erro && b - a > 1) {
+            char *t = suspeitos[perm[a]];
+            suspeitos[perm[a]] = suspeitos[perm[b - 1]];
+            suspeitos[perm[b - 1]] = t;
+        }
+    }
+    int unicas = 0;
+    for (int i = 0; i < n; i++) {
+        if (descartar[i]) {
+            free(pistas[i]);
+            free(suspeitos[i]);
+            continue;
+        }
+        pistas[unicas] = pistas[i];
+        suspeitos[unicas] = suspeitos[i];
+        hashes[unicas++] = hashes[i];
+    }
+    n = unicas;
+    free(perm);
+    free(descartar);
+
+    int nBaldes = n / CHD_LAMBDA + 1;
+    int nSlots = n ? n : 1;
+    uint32_t *desloc = calloc(nBaldes, sizeof(uint32_t));
+    int *tamBalde = calloc(nBaldes, sizeof(int));
+    int *ordemBaldes = malloc(nBaldes * sizeof(int));
+    int *inicioBalde = malloc((nBaldes + 1) * sizeof(int));
+    int *chaves = malloc((n ? n : 1) * sizeof(int));
+    int *slotDe = NULL, *tentativa = malloc((n ? n : 1) * sizeof(int));
+    if (!desloc || !tamBalde || !ordemBaldes || !inicioBalde || !chaves || !tentativa) exit(1);
+
+    /* agrupa as chaves por balde (contagem + prefixo) */
+    for (int i = 0; i < n; i++) tamBalde[(hashes[i] >> 32) % nBaldes]++;
+    inicioBalde[0] = 0;
+    for (int b = 0; b < nBaldes; b++) inicioBalde[b + 1] = inicioBalde[b] + tamBalde[b];
+    for (int b = 0; b < nBaldes; b++) ordemBaldes[b] = inicioBalde[b];
+    for (int i = 0; i < n; i++) chaves[ordemBaldes[(hashes[i] >> 32) % nBaldes]++] = i;
+    for (int b = 0; b < nBaldes; b++) ordemBaldes[b] = b;
+    qsort_r(ordemBaldes, nBaldes, sizeof(int), compararBaldesPorTamanho, tamBalde);
+
+    /* baldes maiores primeiro; se algum não couber, mais um slot */
+    while (!erro) {
+        free(slotDe);
+        slotDe = malloc(nSlots * sizeof(int));
+        if (!slotDe) exit(1);
+        for (int i = 0; i < nSlots; i++) slotDe[i] = -1;
+
+        int falhou = 0;
+        for (int k = 0; k < nBaldes && !falhou && tamBalde[ordemBaldes[k]] > 0; k++) {
+            int b = ordemBaldes[k], ini = inicioBalde[b], tam = tamBalde[b];
+            uint32_t d;
+            for (d = 0; d < CHD_MAX_DESLOC; d++) {
+                int ok = 1;
+                for (int j = 0; j < tam && ok; j++) {
+                    int s = (int) (misturarHash(hashes[chaves[ini + j]], d) % nSlots);
+                    if (slotDe[s] != -1) ok = 0;
+                    else { slotDe[s] = chaves[ini + j]; tentativa[j] = s; }
+                    if (!ok)
+                        for (int t = 0; t < j; t++) slotDe[tentativa[t]] = -1;
+                }
+                if (ok) break;
+            }
+            if (d == CHD_MAX_DESLOC) falhou = 1;
+            else desloc[b] = d;
+        }
+        if (!falhou) break;
+        nSlots++;
+    }
+
+    if (!erro) {
+        fprintf(saida, "/* Gerado por detective-quest-mestre --gerar-hash-perfeita %s.\n"
+                       "   Não edite: altere o catálogo e gere de novo. */\n", caminho);
+        fprintf(saida, "#define CATALOGO_N %d\n#define CATALOGO_SLOTS %d\n"
+                       "#define CATALOGO_BALDES %d\n", n, nSlots, nBaldes);
+        fprintf(saida, "#define CATALOGO_HASH_TESTE 0x%016llxULL\n\n",
+                (unsigned long long) hashBytes("catalogo", 8));
+        fprintf(saida, "static const uint32_t CATALOGO_DESLOC[CATALOGO_BALDES] = {");
+        for (int b = 0; b < nBaldes; b++) fprintf(saida, "%s%u", b ? ", " : " ", desloc[b]);
+        fprintf(saida, " };\n\nstatic const CatalogoPista CATALOGO_PISTAS[CATALOGO_SLOTS] = {\n");
+        for (int i = 0; i < nSlots; i++) {
+            int k = slotDe[i];
+            if (k == -1) { fprintf(saida, "    { NULL, 0, NULL },\n"); continue; }
+            fprintf(saida, "    { ");
+            escreverLiteralC(saida, pistas[k]);
+            fprintf(saida, ", %zu, ", strlen(pistas[k]));
+            escreverLiteralC(saida, suspeitos[k]);
+            fprintf(saida, " },\n");
+        }
+        /* posição de cada pista na ordem do arquivo */
+        for (int i = 0; i < nSlots; i++)
+            if (slotDe[i] != -1) tentativa[slotDe[i]] = i;
+        fprintf(saida, "};\n\nstatic const int CATALOGO_ORDEM[CATALOGO_N ? CATALOGO_N : 1] = {");
+        for (int i = 0; i < n; i++) fprintf(saida, "%s%d", i ? ", " : " ", tentativa[i]);
+        fprintf(saida, "%s };\n", n ? "" : " 0");
+    }
+
+    for (int i = 0; i < n; i++) {
+        free(pistas[i]);
+        free(suspeitos[i]);
+    }
+    free(pistas); free(suspeitos); free(hashes);
+    free(desloc); free(tamBalde); free(ordemBaldes); free(inicioBalde);
+    free(chaves); free(slotDe); free(tentativa);
+    return erro;
+}
+
+/* ==========================
+   TABELA CONCORRENTE
+   ========================== */
+
+#define CARGA_FATIA_MIN (256 * 1024)  /* bytes por worker, no mínimo */
+#define CARGA_BYTES_POR_PISTA 24      /* estimativa para dimensionar os baldes */
+
+void inicializarTabelaConcorrente(TabelaConcorrente *t, size_t capacidade) {
+    t->nBaldes = HASH_CAP_INICIAL;
+    while (t->nBaldes < capacidade) t->nBaldes *= 2;
+    t->baldes = calloc(t->nBaldes, sizeof(EntradaConc*));
+    if (!t->baldes) exit(1);
+    t->n = 0;
+    t->mapa = NULL;
+    t->tamMapa = 0;
+    t->arenas = NULL;
+    t->nArenas = 0;
+}
+
+static const EntradaConc* procurarConcorrente(const EntradaConc *e, const EntradaConc *ate,
+                                              const char *pista, size_t n, uint64_t h) {
+    /* qualquer linha da entrada começa com a mesma pista: basta relaxed */
+    for (; e != ate; e = e->prox)
+        if (e->hash == h && e->comprimento == n &&
+            memcmp(__atomic_load_n(&e->linha, __ATOMIC_RELAXED), pista, n) == 0)
+            return e;
+    return NULL;
+}
+
+/* Registra a linha do catálogo mapeado cuja pista são os n primeiros
+   bytes (linha[n] == ';'). Seguro com outros inseridores e leitores em
+   paralelo, desde que cada thread use a sua arena. Entre linhas
+   repetidas vale a mais adiante no arquivo, qualquer que seja a ordem
+   em que as threads cheguem. Retorna 1 se a pista é nova. */
+int inserirConcorrente(TabelaConcorrente *t, Arena *a, const char *linha, size_t n) {
+    uint64_t h = hashBytes(linha, n);
+    EntradaConc **balde = &t->baldes[h & (t->nBaldes - 1)];
+    EntradaConc *cab = __atomic_load_n(balde, __ATOMIC_ACQUIRE), *visto = NULL, *novo = NULL;
     while (1) {
-        printf("\n====== DETECTIVE QUEST ======\n");
-        printf("1 - Entrar na mansão\n");
-        printf("2 - Ver pistas\n");
-        printf("3 - Fazer acusação\n");
-        printf("0 - Sair\n");
-        printf("Escolha: ");
+        /* só os nós publicados desde a última volta são novidade */
+        EntradaConc *e = (EntradaConc*) procurarConcorrente(cab, visto, linha, n, h);
+        if (e) {
+            const char *atual = __atomic_load_n(&e->linha, __ATOMIC_ACQUIRE);
+            while (atual < linha &&
+                   !__atomic_compare_exchange_n(&e->linha, &atual, linha, 1,
+                                                __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+                ;
+            return 0;
+        }
+        if (!novo) {
+            novo = arenaAlocar(a, sizeof(EntradaConc));
+            novo->hash = h;
+            novo->linha = linha;
+            novo->comprimento = (uint32_t) n;
+        }
+        novo->prox = cab;
+        visto = cab;
+        if (__atomic_compare_exchange_n(balde, &cab, novo, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+            return 1;
+    }
+}
+
+/* Sem trava, mesmo durante uma carga. h = hashBytes(pista, n). Devolve
+   o suspeito como visão dentro do catálogo (sem '\0'), com o
+   comprimento em *ns, ou NULL. */
+const char* buscarSuspeitoConcorrente(const TabelaConcorrente *t, const char *pista,
+                                      size_t n, uint64_t h, size_t *ns) {
+    const EntradaConc *e = __atomic_load_n(&t->baldes[h & (t->nBaldes - 1)], __ATOMIC_ACQUIRE);
+    e = procurarConcorrente(e, NULL, pista, n, h);
+    if (!e) return NULL;
+
+    const char *sus = __atomic_load_n(&e->linha, __ATOMIC_ACQUIRE) + n + 1;
+    const char *fim = t->mapa + t->tamMapa;
+    const char *nl = memchr(sus, '\n', fim - sus);
+    *ns = (nl ? nl : fim) - sus;
+    if (*ns > 0 && sus[*ns - 1] == '\r') (*ns)--;
+    return sus;
+}
+
+typedef struct TrabalhoCarga {
+    TabelaConcorrente *t;
+    Arena *arena;
+    const char *mapa;
+    size_t tam;
+    size_t inicio, fim;    /* a fatia: linhas que começam aqui dentro */
+    long novas;
+    long erro;             /* offset da 1ª linha malformada; -1 = nenhuma */
+} TrabalhoCarga;
+
+static void* workerCarga(void *arg) {
+    TrabalhoCarga *w = arg;
+    const char *mapa = w->mapa;
+    size_t p = w->inicio;
+    if (p > 0 && mapa[p - 1] != '\n') {
+        const char *nl = memchr(mapa + p, '\n', w->tam - p);
+        p = nl ? (size_t) (nl - mapa) + 1 : w->tam;
+    }
+
+    while (p < w->fim) {
+        const char *linha = mapa + p;
+        const char *nl = memchr(linha, '\n', w->tam - p);
+        size_t len = nl ? (size_t) (nl - linha) : w->tam - p;
+        size_t prox = p + len + 1;
+        if (len > 0 && linha[len - 1] == '\r') len--;
+
+        if (len > 0 && linha[0] != '#') {
+            const char *sep = memchr(linha, ';', len);
+            if (!sep || sep == linha || sep == linha + len - 1) {
+                w->erro = (long) p;
+                break;
+            }
+            w->novas += inserirConcorrente(w->t, w->arena, linha, sep - linha);
+        }
+        p = prox;
+    }
+    return NULL;
+}
+
+/* Carrega um catálogo "pista;suspeito" (mesmo formato de
+   gerarHashPerfeita) com nThreads workers (0 = nº de CPUs), cada um
+   numa fatia do arquivo mapeado: a carga é uma passada só, com as
+   páginas entrando por falta, e o mapa fica com a tabela até
+   liberarTabelaConcorrente. Retorna 0 se deu certo. */
+int carregarCatalogoParalelo(TabelaConcorrente *t, const char *caminho, int nThreads) {
+    int fd = open(caminho, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    size_t tam = st.st_size;
+    if (tam == 0) {
+        close(fd);
+        inicializarTabelaConcorrente(t, 0);
+        return 0;
+    }
+    const char *mapa = mmap(NULL, tam, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED) return -1;
+    madvise((void*) mapa, tam, MADV_WILLNEED);
+
+    if (nThreads <= 0) nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nThreads <= 0) nThreads = 1;
+    if ((size_t) nThreads > tam / CARGA_FATIA_MIN + 1) nThreads = (int) (tam / CARGA_FATIA_MIN + 1);
+
+    double t0 = estatAtiva ? agoraNs() : 0;
+    inicializarTabelaConcorrente(t, tam / CARGA_BYTES_POR_PISTA);
+    t->mapa = mapa;
+    t->tamMapa = tam;
+    t->nArenas = nThreads;
+    t->arenas = malloc(nThreads * sizeof(Arena));
+    TrabalhoCarga *w = malloc(nThreads * sizeof(TrabalhoCarga));
+    pthread_t *th = malloc(nThreads * sizeof(pthread_t));
+    if (!t->arenas || !w || !th) exit(1);
+
+    for (int i = 0; i < nThreads; i++) {
+        inicializarArena(&t->arenas[i]);
+        w[i] = (TrabalhoCarga) { t, &t->arenas[i], mapa, tam,
+                                 tam / nThreads * i, i == nThreads - 1 ? tam : tam / nThreads * (i + 1),
+                                 0, -1 };
+    }
+    for (int i = 1; i < nThreads; i++)
+        if (pthread_create(&th[i], NULL, workerCarga, &w[i]) != 0) exit(1);
+    workerCarga(&w[0]);
+
+    long erro = -1;
+    for (int i = 0; i < nThreads; i++) {
+        if (i > 0) pthread_join(th[i], NULL);
+        t->n += w[i].novas;
+        if (w[i].erro != -1 && (erro == -1 || w[i].erro < erro)) erro = w[i].erro;
+    }
+    if (erro != -1) {
+        long numLinha = 1;
+        for (const char *q = mapa; (q = memchr(q, '\n', mapa + erro - q)); q++) numLinha++;
+        fprintf(stderr, "%s:%ld: esperado \"pista;suspeito\"\n", caminho, numLinha);
+    } else if (estatAtiva) {
+        fprintf(stderr, "catálogo %s: %ld pistas, %d threads, %.1f ms\n",
+                caminho, t->n, nThreads, (agoraNs() - t0) / 1e6);
+    }
+
+    free(w);
+    free(th);
+    if (erro != -1) {
+        liberarTabelaConcorrente(t);
+        return -1;
+    }
+    return 0;
+}
+
+/* Passa para a tabela do jogo as associações das pistas que aparecem
+   nas salas da mansão. O catálogo inteiro pode ter milhões de pistas,
+   mas o jogo só consulta estas, por id internado. */
+void importarCatalogo(HashTable *ht, const TabelaConcorrente *t, const MansaoPlana *m) {
+    char *nome = NULL;     /* o suspeito com '\0', para inserirMapping */
+    size_t capNome = 0;
+    for (int i = 0; i < m->n; i++) {
+        int p = m->salas[i].pista;
+        if (p == SEM_PISTA) continue;
+        size_t ns;
+        const char *sus = buscarSuspeitoConcorrente(t, textoInterno(p), comprimentoInterno(p),
+                                                    internos.hashes[p], &ns);
+        if (!sus) continue;
+        if (ns + 1 > capNome) {
+            capNome = ns + 1 > 64 ? ns + 1 : 64;
+            nome = realloc(nome, capNome);
+            if (!nome) exit(1);
+        }
+        memcpy(nome, sus, ns);
+        nome[ns] = '\0';
+        inserirMapping(ht, textoInterno(p), nome);
+    }
+    free(nome);
+}
+
+void liberarTabelaConcorrente(TabelaConcorrente *t) {
+    for (int i = 0; i < t->nArenas; i++)
+        liberarArena(&t->arenas[i]);
+    free(t->arenas);
+    free(t->baldes);
+    if (t->mapa) munmap((void*) t->mapa, t->tamMapa);
+    t->mapa = NULL;
+    t->tamMapa = 0;
+    t->arenas = NULL;
+    t->baldes = NULL;
+    t->nArenas = 0;
+    t->nBaldes = 0;
+    t->n = 0;
+}
+
+/* ==========================
+   ACUSAÇÃO
+   ========================== */
 
-        scanf("%d", &opc);
-        limparBuffer();
+int contarPistasAssociadas(PistaNode *r, HashTable *ht, int suspeito) {
+    CursorPistas c;
+    int cont = 0;
+    iniciarCursor(&c, r);
+    for (int p; (p = proximaPista(&c)) != -1; )
+        if (buscarSuspeitoId(ht, p) == suspeito) cont++;
+    return cont;
+}
+
+/* Sem -mpopcnt o laço chamaria __popcountdi2 a cada palavra; os clones
+   são escolhidos pela CPU na carga do programa (ifunc). O resolvedor
+   roda antes do runtime do TSan, então builds com -fsanitize=thread
+   ficam sem eles. */
+#if defined(__x86_64__) && defined(__linux__) && defined(__GNUC__) && !defined(__clang__) && \
+    !defined(__SANITIZE_THREAD__)
+#define CLONES_POPCOUNT __attribute__((target_clones("popcnt", "default")))
+#else
+#define CLONES_POPCOUNT
+#endif
+
+/* AND palavra a palavra da linha esparsa com as coletadas, mais
+   popcount; a linha está em ordem, então para na 1ª palavra que as
+   coletadas ainda não cobrem. */
+CLONES_POPCOUNT
+static int contarComuns(const LinhaEvidencias *l, const uint64_t *coletadas, int palavras) {
+    int cont = 0;
+    for (int i = 0; i < l->n && l->p[i].palavra < palavras; i++)
+        cont += __builtin_popcountll(l->p[i].bits & coletadas[l->p[i].palavra]);
+    return cont;
+}
+
+/* Pistas coletadas que apontam para o suspeito (id), pela linha de
+   evidências dele: O(palavras da linha). */
+int evidenciasDoSuspeito(const HashTable *ht, const Investigacao *inv, int suspeito) {
+    if (suspeito < 0 || suspeito >= ht->capSuspeitos || ht->indiceSuspeito[suspeito] == -1)
+        return 0;
+    return contarComuns(&ht->evidencias[ht->indiceSuspeito[suspeito]], inv->coletadas,
+                        inv->palavrasColetadas);
+}
+
+/* pontos[i] = evidências contra ht->suspeitos[i], para todo o registro:
+   O(palavras de todas as linhas), sem tocar na BST. */
+void pontuarSuspeitos(const HashTable *ht, const Investigacao *inv, int *pontos) {
+    for (int i = 0; i < ht->nSuspeitos; i++)
+        pontos[i] = contarComuns(&ht->evidencias[i], inv->coletadas, inv->palavrasColetadas);
+}
+
+/* Registra a acusação e devolve quantas pistas apontam para o suspeito.
+   O veredito sai das linhas de evidências; o placar, derivado das
+   mesmas coletadas, mostra o mesmo número. */
+int acusar(const HashTable *ht, Investigacao *inv, int suspeito) {
+    int cont = evidenciasDoSuspeito(ht, inv, suspeito);
+    inv->acusado = suspeito;
+    inv->acertou = cont >= 2;
+    return cont;
+}
+
+/* O menu de acusação lista o registro de suspeitos da hash, na ordem em
+   que apareceram no catálogo. */
+static void escolherAcusado(const HashTable *ht, Investigacao *inv) {
+    if (!inv->pistas) {
+        SAIDA("\nSem pistas coletadas.\n");
+        return;
+    }
+
+    int op;
+    const char *escolha;
+
+    SAIDA("\nQuem você deseja acusar?\n");
+    for (int i = 0; i < ht->nSuspeitos; i++)
+        SAIDA("%d - %s\n", i + 1, textoInterno(ht->suspeitos[i]));
+    SAIDA("0 - Cancelar\n");
+    SAIDA("Escolha: ");
+
+    op = lerOpcao();
+    if (op < 1 || op > ht->nSuspeitos) return;
+    escolha = textoInterno(ht->suspeitos[op - 1]);
+
+    int cont = acusar(ht, inv, ht->suspeitos[op - 1]);
+
+    SAIDA("\nVocê acusou: %s\n", escolha);
+    SAIDA("Pistas que apontam para ele: %d\n", cont);
+
+    if (cont >= 2)
+        SAIDA(">>> ACUSAÇÃO CORRETA!\n");
+    else
+        SAIDA(">>> ACUSAÇÃO FALSA.\n");
+}
+
+void fazerAcusacao(const HashTable *ht, Investigacao *inv) {
+    double t0 = estatAtiva ? agoraNs() : 0;
+    escolherAcusado(ht, inv);
+    ESTAT_SOMA(chamadasAcusacao, 1);
+    ESTAT_SOMA(nsAcusacao, (long) (agoraNs() - t0));
+}
+
+/* ==========================
+   EXPLORAR MANSÃO
+   ========================== */
+
+/* Credita uma pista recém-coletada: liga o bit da entrada (e, com ele,
+   o placar do suspeito). Retorna a entrada da pista na hash, ou -1 se
+   ela não tem suspeito. */
+static int creditarPista(const HashTable *ht, Investigacao *inv, int pista) {
+    int e = buscarEntradaPista(ht, pista);
+    if (e == -1) return -1;
+    marcarColetada(inv, e, ht->entradas[e].suspeito);
+    return e;
+}
+
+/* Entra na sala: coleta a pista, se houver e ainda não tiver sido
+   coletada, e credita o suspeito associado. Retorna o id do suspeito
+   creditado ou -1. */
+int visitarSala(const MansaoPlana *m, HashTable *ht, Investigacao *inv, int sala) {
+    inv->salaAtual = sala;
+    int pista = m->salas[sala].pista;
+    int e = -1;
+    if (pista != SEM_PISTA && inserirPersistente(arenaDaInvestigacao(inv), &inv->pistas, pista))
+        e = creditarPista(ht, inv, pista);
+    int sus = e == -1 ? -1 : ht->entradas[e].suspeito;
+    if (inv->historico && inv->historico->creditado == CREDITO_PENDENTE) {
+        inv->historico->creditado = sus;
+        inv->historico->coletada = e;
+    }
+    return sus;
+}
+
+/* Guarda o ponto atual antes de sair da sala; o crédito da sala de
+   destino é anotado pela próxima visitarSala. */
+void registrarMovimento(Investigacao *inv) {
+    Passo *p = arenaAlocar(arenaDaInvestigacao(inv), sizeof(Passo));
+    p->anterior = inv->historico;
+    p->pistas = inv->pistas;
+    p->sala = inv->salaAtual;
+    p->creditado = CREDITO_PENDENTE;
+    p->coletada = -1;
+    inv->historico = p;
+}
+
+/* Volta ao ponto anterior ao último movimento: a BST antiga volta a
+   valer em O(1) e só o suspeito creditado na chegada perde a evidência.
+   Retorna a sala de volta, ou -1 se não há movimento a desfazer. */
+int desfazerMovimento(Investigacao *inv) {
+    Passo *p = inv->historico;
+    if (!p) return -1;
+    if (p->coletada >= 0) desmarcarColetada(inv, p->coletada, p->creditado);
+    inv->pistas = p->pistas;
+    inv->salaAtual = p->sala;
+    inv->historico = p->anterior;
+    return p->sala;
+}
+
+/* A exploração termina na Saída ou num cômodo sem caminhos. Com grafo,
+   as passagens extras também contam como caminho. */
+int fimDaExploracao(const MansaoPlana *m, int sala) {
+    if (m->nomes[sala] == m->idSaida) return 1;
+    if (m->grafo) return m->grafo->inicio[sala + 1] == m->grafo->inicio[sala];
+    return m->salas[sala].esq == -1 && m->salas[sala].dir == -1;
+}
+
+static int alvoSaida(int sala, const void *ctx) {
+    const MansaoPlana *m = ctx;
+    return m->nomes[sala] == m->idSaida;
+}
+
+typedef struct AlvoPista {
+    const MansaoPlana *m;
+    const Investigacao *inv;
+} AlvoPista;
+
+static int alvoPistaNova(int sala, const void *ctx) {
+    const AlvoPista *a = ctx;
+    int p = a->m->salas[sala].pista;
+    return p != SEM_PISTA && !existePistaBST(a->inv->pistas, p);
+}
+
+#define ROTA_MAX 32   /* salas exibidas de uma rota */
+
+static void mostrarRota(const MansaoPlana *m, int origem, int (*alvo)(int, const void*),
+                        const void *ctx, const char *descricao) {
+    int rota[ROTA_MAX];
+    long long custo;
+    int len = rotaMaisCurta(m->grafo, origem, alvo, ctx, rota, ROTA_MAX, &custo);
+    if (len < 0) {
+        SAIDA("Nenhum caminho daqui até %s.\n", descricao);
+        return;
+    }
+    SAIDA("Rota até %s (%d passagens, custo %lld):\n", descricao, len - 1, custo);
+    for (int i = 0; i < len && i < ROTA_MAX; i++)
+        SAIDA("%s%s", i ? " -> " : "  ", textoInterno(m->nomes[rota[i]]));
+    SAIDA("%s\n", len > ROTA_MAX ? " -> ..." : "");
+}
+
+/* Passagens extras (além de esquerda/direita) que saem da sala. */
+static int passagensExtras(const MansaoPlana *m, int sala, int *saida, int max) {
+    const GrafoMansao *g = m->grafo;
+    int n = 0;
+    for (int k = g->inicio[sala]; k < g->inicio[sala + 1] && n < max; k++) {
+        int w = g->destino[k];
+        if (w != m->salas[sala].esq && w != m->salas[sala].dir) saida[n++] = w;
+    }
+    return n;
+}
+
+static void percorrerMansao(const MansaoPlana *m, HashTable *ht, Investigacao *inv) {
+    int at = inv->retomarEm >= 0 ? inv->retomarEm : 0;
+    int opc;
+    inv->retomarEm = -1;
+
+    while (1) {
+        const SalaQuente *sala = &m->salas[at];
+        SAIDA("\nVocê está em: %s\n", textoInterno(m->nomes[at]));
+
+        int sus = visitarSala(m, ht, inv, at);
+        if (sala->pista != SEM_PISTA) {
+            SAIDA("Encontrou a pista: %s\n", textoInterno(sala->pista));
+            if (sus != -1) SAIDA("Associada a: %s\n", textoInterno(sus));
+        }
+
+        if (fimDaExploracao(m, at)) {
+
+            if (!modoLote) {
+                printf("\n--- FIM DA EXPLORAÇÃO ---\n");
+                printf("Pistas coletadas:\n");
+                exibirPistasInOrder(inv->pistas);
+                exibirSuspeitosProvaveis(&inv->placar, 1);
+            }
+
+            fazerAcusacao(ht, inv);
+            return;
+        }
+
+        SAIDA("\n1 - Ir para esquerda");
+        if (sala->esq == -1) SAIDA(" (sem saída)");
+
+        SAIDA("\n2 - Ir para direita");
+        if (sala->dir == -1) SAIDA(" (sem saída)");
+
+        int extras[9];
+        int nExtras = 0;
+        SAIDA("\n3 - Sair");
+        if (m->grafo) {
+            nExtras = passagensExtras(m, at, extras, 9);
+            SAIDA("\n4 - Rota mais curta até a Saída");
+            SAIDA("\n5 - Pista não coletada mais próxima");
+            if (nExtras) SAIDA("\n6 - Outras passagens (%d)", nExtras);
+        }
+        if (inv->historico) SAIDA("\n7 - Voltar (desfazer o último movimento)");
+        SAIDA("\nEscolha: ");
+        opc = lerOpcao();
+
+        if (opc == 1 && sala->esq != -1) { registrarMovimento(inv); at = sala->esq; }
+        else if (opc == 2 && sala->dir != -1) { registrarMovimento(inv); at = sala->dir; }
+        else if (opc == 3 || opc == OPCAO_FIM) return;
+        else if (opc == 4 && m->grafo) mostrarRota(m, at, alvoSaida, m, "a Saída");
+        else if (opc == 5 && m->grafo) {
+            AlvoPista a = { m, inv };
+            mostrarRota(m, at, alvoPistaNova, &a, "uma pista nova");
+        }
+        else if (opc == 6 && nExtras) {
+            for (int i = 0; i < nExtras; i++)
+                SAIDA("%d - %s\n", i + 1, textoInterno(m->nomes[extras[i]]));
+            SAIDA("Escolha: ");
+            int p = lerOpcao();
+            if (p >= 1 && p <= nExtras) { registrarMovimento(inv); at = extras[p - 1]; }
+            else SAIDA("Movimento inválido.\n");
+        }
+        else if (opc == 7 && inv->historico) at = desfazerMovimento(inv);
+        else SAIDA("Movimento inválido.\n");
+    }
+}
+
+void explorar(const MansaoPlana *m, HashTable *ht, Investigacao *inv) {
+    if (!estatAtiva) {
+        percorrerMansao(m, ht, inv);
+        return;
+    }
+    long acusacao0 = __atomic_load_n(&estat.nsAcusacao, __ATOMIC_RELAXED);
+    double t0 = agoraNs();
+    percorrerMansao(m, ht, inv);
+    long total = (long) (agoraNs() - t0);
+    ESTAT_SOMA(chamadasExplorar, 1);
+    ESTAT_SOMA(nsExplorar, total - (__atomic_load_n(&estat.nsAcusacao, __ATOMIC_RELAXED) - acusacao0));
+}
+
+/* ==========================
+   SALVAR / RETOMAR INVESTIGAÇÃO
+   ========================== */
+
+static const char *arqSalvamento = "investigacao.dqs";
+
+static int contarNos(const PistaNode *r) {
+    CursorPistas c;
+    int n = 0;
+    iniciarCursor(&c, r);
+    while (proximaPista(&c) != -1) n++;
+    return n;
+}
+
+/* Grava a partida no formato .dqs. Retorna 0 se deu certo. */
+int salvarInvestigacao(const Investigacao *inv, const MansaoPlana *m, const char *caminho) {
+    int total = contarNos(inv->pistas);
+    int *ids = malloc((total + 1) * sizeof(int));
+    if (!ids) exit(1);
+    CursorPistas c;
+    iniciarCursor(&c, inv->pistas);
+    int n = proximasPistas(&c, ids, total);
+    int nt = n;
+    if (inv->acusado != -1) ids[nt++] = inv->acusado;
+
+    FILE *f = fopen(caminho, "wb");
+    int erro = !f;
+    if (f) {
+        DqsCabecalho cab;
+        memcpy(cab.magica, DQS_MAGICA, 4);
+        cab.versao = DQS_VERSAO;
+        cab.nSalas = m->n;
+        cab.salaAtual = inv->salaAtual;
+        cab.acusado = inv->acusado == -1 ? -1 : n;
+        cab.acertou = inv->acertou;
+        cab.nPistas = n;
+        cab.nTextos = nt;
+        fwrite(&cab, sizeof(cab), 1, f);
+
+        uint32_t off = 0;
+        for (int t = 0; t < nt; t++) {
+            DqsTexto e = { off, (uint32_t) comprimentoInterno(ids[t]) };
+            fwrite(&e, sizeof(e), 1, f);
+            off += e.comprimento + 1;
+        }
+        for (int t = 0; t < nt; t++)
+            fwrite(textoInterno(ids[t]), 1, comprimentoInterno(ids[t]) + 1, f);
+        erro = ferror(f);
+        if (fclose(f) != 0) erro = 1;
+    }
+
+    free(ids);
+    return erro ? -1 : 0;
+}
+
+/* Liga nos[lo..hi) numa AVL perfeitamente balanceada (o meio é a raiz). */
+static PistaNode* ligarBalanceada(PistaNode *nos, int lo, int hi) {
+    if (lo >= hi) return NULL;
+    int meio = lo + (hi - lo) / 2;
+    PistaNode *r = &nos[meio];
+    r->esq = ligarBalanceada(nos, lo, meio);
+    r->dir = ligarBalanceada(nos, meio + 1, hi);
+    atualizarAltura(r);
+    return r;
+}
+
+/* Substitui inv pela partida salva em caminho; o placar é recontado a
+   partir das pistas. Retorna 0 se deu certo e -1 (inv intacta) se o
+   arquivo não existe, está corrompido ou é de outra mansão. */
+int carregarInvestigacao(Investigacao *inv, const MansaoPlana *m, HashTable *ht,
+                         const char *caminho) {
+    int fd = open(caminho, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(DqsCabecalho)) {
+        close(fd);
+        return -1;
+    }
+    size_t tam = st.st_size;
+    const unsigned char *mapa = mmap(NULL, tam, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED) return -1;
+    madvise((void*) mapa, tam, MADV_SEQUENTIAL);
+
+    const DqsCabecalho *cab = (const DqsCabecalho*) mapa;
+    Investigacao nova;
+    inicializarInvestigacao(&nova);
+    int ok = 0;
+
+    uint64_t n = cab->nPistas, nt = cab->nTextos;
+    uint64_t inicioTextos = sizeof(DqsCabecalho) + nt * sizeof(DqsTexto);
+    if (memcmp(cab->magica, DQS_MAGICA, 4) != 0 || cab->versao != DQS_VERSAO ||
+        cab->nSalas != (uint32_t) m->n || cab->salaAtual < 0 || cab->salaAtual >= m->n ||
+        n > INT32_MAX || nt != n + (cab->acusado != -1) ||
+        (cab->acusado != -1 && (uint64_t) cab->acusado != n) || inicioTextos > tam)
+        goto fim;
+
+    const DqsTexto *ent = (const DqsTexto*) (mapa + sizeof(DqsCabecalho));
+    const char *textos = (const char*) (mapa + inicioTextos);
+    size_t tamTextos = tam - inicioTextos;
+    for (uint64_t t = 0; t < nt; t++)
+        if ((uint64_t) ent[t].offset + ent[t].comprimento >= tamTextos ||
+            textos[ent[t].offset + ent[t].comprimento] != '\0' ||
+            memchr(textos + ent[t].offset, '\0', ent[t].comprimento))
+            goto fim;
+
+    /* a ordem estrita é o que garante uma BST válida sem reinserir */
+    for (uint64_t t = 1; t < n; t++)
+        if (strcmp(textos + ent[t - 1].offset, textos + ent[t].offset) >= 0)
+            goto fim;
+
+    if (n > 0) {
+        PistaNode *nos = arenaAlocar(arenaDaInvestigacao(&nova), n * sizeof(PistaNode));
+        ESTAT_SOMA(nosPistaCriados, (long) n);
+        for (uint64_t t = 0; t < n; t++) {
+            int id = internarN(textos + ent[t].offset, ent[t].comprimento);
+            nos[t].pista = id;
+            nos[t].prefixo = prefixoPista(id);
+            creditarPista(ht, &nova, id);
+        }
+        nova.pistas = ligarBalanceada(nos, 0, (int) n);
+        ESTAT_MAX(maxAlturaBST, nova.pistas->altura);
+    }
+    nova.salaAtual = nova.retomarEm = cab->salaAtual;
+    if (cab->acusado != -1) {
+        nova.acusado = internarN(textos + ent[n].offset, ent[n].comprimento);
+        nova.acertou = cab->acertou != 0;
+    }
+    ok = 1;
+
+fim:
+    munmap((void*) mapa, tam);
+    if (!ok) {
+        liberarInvestigacao(&nova);
+        return -1;
+    }
+    liberarInvestigacao(inv);
+    *inv = nova;
+    return 0;
+}
+
+/* ==========================
+   RELATÓRIO DE INSTRUMENTAÇÃO
+   ========================== */
+
+static const char *const FAIXAS_SONDAGEM[ESTAT_FAIXAS] = {
+    "0", "1", "2-3", "4-7", "8-15", "16-31", "32+"
+};
+
+/* Distância de cada slot ocupado até o slot de origem do seu hash:
+   é o "comprimento de cadeia" da sondagem linear. */
+static void ocupacaoSlots(const HashSlot *slots, int cap, long faixas[ESTAT_FAIXAS]) {
+    unsigned int mask = cap - 1;
+    for (int f = 0; f < ESTAT_FAIXAS; f++) faixas[f] = 0;
+    for (int i = 0; i < cap; i++)
+        if (slots[i].indice != -1)
+            faixas[faixaSondagem((i - slots[i].hash) & mask)]++;
+}
+
+static void relatarTabelaTexto(FILE *f, const char *nome, const EstatTabela *t,
+                               const long ocup[ESTAT_FAIXAS], int ocupados, int cap) {
+    fprintf(f, "%s: %d/%d slots (carga %.2f), %ld operações, %.2f sondagens/op (máx %ld)\n",
+            nome, ocupados, cap, cap ? (double) ocupados / cap : 0.0, t->operacoes,
+            t->operacoes ? (double) t->sondagens / t->operacoes : 0.0, t->maxSondagens);
+    fprintf(f, "  %-8s %12s %12s\n", "sondagens", "operações", "slots");
+    for (int i = 0; i < ESTAT_FAIXAS; i++)
+        fprintf(f, "  %-8s %12ld %12ld\n", FAIXAS_SONDAGEM[i], t->faixas[i], ocup[i]);
+}
+
+static void relatarTabelaJson(FILE *f, const char *nome, const EstatTabela *t,
+                              const long ocup[ESTAT_FAIXAS], int ocupados, int cap) {
+    fprintf(f, "\"%s\":{\"slots\":%d,\"ocupados\":%d,\"operacoes\":%ld,\"sondagens\":%ld,"
+               "\"max_sondagens\":%ld,\"hist_operacoes\":[", nome, cap, ocupados,
+            t->operacoes, t->sondagens, t->maxSondagens);
+    for (int i = 0; i < ESTAT_FAIXAS; i++) fprintf(f, "%s%ld", i ? "," : "", t->faixas[i]);
+    fprintf(f, "],\"hist_slots\":[");
+    for (int i = 0; i < ESTAT_FAIXAS; i++) fprintf(f, "%s%ld", i ? "," : "", ocup[i]);
+    fprintf(f, "]}");
+}
+
+/* Imprime os contadores em texto e, numa última linha, em JSON.
+   inv pode ser NULL (servidor: cada sessão tem a sua). */
+void relatarEstatisticas(FILE *f, const HashTable *ht, const Investigacao *inv) {
+    if (!estatAtiva) {
+        fprintf(f, "Instrumentação desligada (defina DQ_STATS=1 no ambiente).\n");
+        return;
+    }
+    Estatisticas e;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    e = estat;
+
+    long ocupPistas[ESTAT_FAIXAS], ocupInternos[ESTAT_FAIXAS];
+    ocupacaoSlots(ht->slots, ht->capacidade, ocupPistas);
+    ocupacaoSlots(internos.slots, internos.capacidade, ocupInternos);
+    int altura = inv && inv->pistas ? inv->pistas->altura : 0;
+
+    fprintf(f, "\n====== ESTATÍSTICAS ======\n");
+    relatarTabelaTexto(f, "Hash de pistas", &e.pistas, ocupPistas, ht->tamanho, ht->capacidade);
+    relatarTabelaTexto(f, "Pool de strings", &e.internos, ocupInternos, internos.total,
+                       internos.capacidade);
+    fprintf(f, "buscarSuspeitoPorPista: %ld chamadas\n", e.buscasSuspeito);
+    fprintf(f, "BST de pistas: altura atual %d (máx %ld); %ld inserções, %.2f comparações/inserção;"
+               " %ld buscas, %.2f comparações/busca\n", altura, e.maxAlturaBST, e.insercoesBST,
+            e.insercoesBST ? (double) e.comparacoesInsercao / e.insercoesBST : 0.0, e.buscasBST,
+            e.buscasBST ? (double) e.comparacoesBusca / e.buscasBST : 0.0);
+    fprintf(f, "Alocações: %ld salas, %ld nós de pista, %ld entradas da hash; %ld blocos de arena"
+               " (%ld bytes), %ld redimensionamentos de slots\n", e.salasCriadas,
+            e.nosPistaCriados, e.entradasCriadas, e.blocosArena, e.bytesArena,
+            e.redimensionamentos);
+    fprintf(f, "Tempo: explorar %.3f ms em %ld chamadas; fazerAcusacao %.3f ms em %ld chamadas\n",
+            e.nsExplorar / 1e6, e.chamadasExplorar, e.nsAcusacao / 1e6, e.chamadasAcusacao);
+
+    fprintf(f, "{");
+    relatarTabelaJson(f, "hash_pistas", &e.pistas, ocupPistas, ht->tamanho, ht->capacidade);
+    fprintf(f, ",");
+    relatarTabelaJson(f, "pool_strings", &e.internos, ocupInternos, internos.total,
+                      internos.capacidade);
+    fprintf(f, ",\"buscas_suspeito\":%ld,\"bst\":{\"altura\":%d,\"max_altura\":%ld,"
+               "\"insercoes\":%ld,\"comparacoes_insercao\":%ld,\"buscas\":%ld,"
+               "\"comparacoes_busca\":%ld},", e.buscasSuspeito, altura, e.maxAlturaBST,
+            e.insercoesBST, e.comparacoesInsercao, e.buscasBST, e.comparacoesBusca);
+    fprintf(f, "\"alocacoes\":{\"salas\":%ld,\"nos_pista\":%ld,\"entradas_hash\":%ld,"
+               "\"blocos_arena\":%ld,\"bytes_arena\":%ld,\"redimensionamentos\":%ld},",
+            e.salasCriadas, e.nosPistaCriados, e.entradasCriadas, e.blocosArena, e.bytesArena,
+            e.redimensionamentos);
+    fprintf(f, "\"tempo\":{\"explorar_ns\":%ld,\"explorar_chamadas\":%ld,"
+               "\"acusacao_ns\":%ld,\"acusacao_chamadas\":%ld}}\n",
+            e.nsExplorar, e.chamadasExplorar, e.nsAcusacao, e.chamadasAcusacao);
+}
+
+/* ==========================
+   SESSÃO
+   ========================== */
+
+#define PAGINA_PISTAS 10  /* pistas por página em "Ver pistas" */
+
+/* Lista as pistas de PAGINA_PISTAS em PAGINA_PISTAS, puxando do cursor
+   só o que vai ser mostrado; o jogador pode parar em qualquer página.
+   Em lote nada é impresso, mas a escolha de página é lida do mesmo
+   jeito, para uma sessão gravada ser reproduzida sem dessincronizar. */
+static void verPistasPaginadas(const Investigacao *inv) {
+    CursorPistas c;
+    int ids[PAGINA_PISTAS];
+    int pagina = 0;
+    iniciarCursor(&c, inv->pistas);
+
+    if (!inv->pistas) {
+        SAIDA("\nSem pistas coletadas.\n");
+        return;
+    }
+    while (1) {
+        int n = proximasPistas(&c, ids, PAGINA_PISTAS);
+        SAIDA("\nPistas (página %d):\n", ++pagina);
+        for (int i = 0; i < n; i++)
+            SAIDA(" - %s\n", textoInterno(ids[i]));
+        if (c.topo == 0) return;
+
+        SAIDA("1 - Próxima página\n0 - Voltar\nEscolha: ");
+        if (lerOpcao() != 1) return;
+    }
+}
+
+#define CONSULTA_MAX 50   /* resultados exibidos por consulta */
+
+/* Busca por prefixo ou por faixa alfabética entre as pistas coletadas. */
+static void consultarPistas(Investigacao *inv) {
+    char de[128], ate[128];
+    int ids[CONSULTA_MAX];
+    int n;
+
+    SAIDA("\n1 - Pistas que começam com...\n2 - Pistas de A até B\n0 - Voltar\nEscolha: ");
+    int op = lerOpcao();
+    if (op == 1) {
+        SAIDA("Prefixo: ");
+        if (lerLinha(de, sizeof de) < 0) return;
+        n = buscarPistasPrefixo(inv->pistas, de, ids, CONSULTA_MAX);
+    } else if (op == 2) {
+        SAIDA("De (vazio = início): ");
+        if (lerLinha(de, sizeof de) < 0) return;
+        SAIDA("Até (vazio = fim): ");
+        if (lerLinha(ate, sizeof ate) < 0) return;
+        n = buscarPistasIntervalo(inv->pistas, de[0] ? de : NULL, ate[0] ? ate : NULL,
+                                  ids, CONSULTA_MAX);
+    } else {
+        return;
+    }
+
+    if (n == 0) SAIDA("Nenhuma pista encontrada.\n");
+    for (int i = 0; i < n; i++)
+        SAIDA(" - %s\n", textoInterno(ids[i]));
+    if (n == CONSULTA_MAX) SAIDA("(mostrando as %d primeiras)\n", CONSULTA_MAX);
+}
+
+#define RAMOS_MAX 8   /* ramos abertos numa sessão, contando o original */
+
+/* Ramos da sessão. O ativo fica sempre em *inv (é nele que o menu
+   joga); o seu lugar em ramos fica sem uso até a próxima troca. */
+typedef struct Ramos {
+    Investigacao ramos[RAMOS_MAX];
+    int n, ativo;
+} Ramos;
+
+static void resumirRamo(const MansaoPlana *m, const Investigacao *r, int num, int ativo) {
+    int top;
+    SAIDA("%s%d - %s, %d pistas", ativo ? "* " : "  ", num,
+          textoInterno(m->nomes[r->salaAtual]), contarNos(r->pistas));
+    if (topSuspeitos(&r->placar, 1, &top) == 1)
+        SAIDA(", mais provável: %s (%d)", textoInterno(top), evidenciasContra(&r->placar, top));
+    SAIDA("\n");
+}
+
+/* Lista os ramos, troca o ativo ou abre um ramo novo a partir dele. */
+static void gerenciarRamos(const MansaoPlana *m, Investigacao *inv, Ramos *g) {
+    SAIDA("\nRamos da investigação:\n");
+    for (int i = 0; i < g->n; i++)
+        resumirRamo(m, i == g->ativo ? inv : &g->ramos[i], i + 1, i == g->ativo);
+    if (g->n < RAMOS_MAX) SAIDA("  %d - Abrir ramo a partir do ativo\n", g->n + 1);
+    SAIDA("0 - Voltar\nEscolha: ");
+
+    int op = lerOpcao();
+    if (op < 1 || op > g->n + (g->n < RAMOS_MAX) || op - 1 == g->ativo) return;
+    if (op == g->n + 1) ramificarInvestigacao(&g->ramos[g->n++], inv);
+
+    g->ramos[g->ativo] = *inv;
+    g->ativo = op - 1;
+    *inv = g->ramos[g->ativo];
+    SAIDA("Ramo %d ativo.\n", op);
+}
+
+/* Menu principal de uma investigação. Retorna 1 se o jogador saiu
+   pela opção 0 e 0 se a entrada acabou antes disso. Ramos abertos
+   durante a sessão são liberados aqui; o ativo fica em *inv. */
+int jogarSessao(const MansaoPlana *m, HashTable *ht, Investigacao *inv) {
+    Ramos g = { .n = 1, .ativo = 0 };
+    int opc;
+    while (1) {
+        SAIDA("\n====== DETECTIVE QUEST ======\n");
+        SAIDA("1 - Entrar na mansão\n");
+        SAIDA("2 - Ver pistas\n");
+        SAIDA("3 - Fazer acusação\n");
+        SAIDA("4 - Suspeitos mais prováveis\n");
+        SAIDA("5 - Salvar investigação\n");
+        SAIDA("6 - Estatísticas internas\n");
+        SAIDA("7 - Buscar pistas\n");
+        SAIDA("8 - Suspeitos e suas pistas\n");
+        SAIDA("9 - Ramos da investigação\n");
+        SAIDA("0 - Sair\n");
+        SAIDA("Escolha: ");
+
+        opc = lerOpcao();
+
+        if (opc == 1) explorar(m, ht, inv);
+        else if (opc == 2) verPistasPaginadas(inv);
+        else if (opc == 3) fazerAcusacao(ht, inv);
+        else if (opc == 4) { if (!modoLote) exibirSuspeitosProvaveis(&inv->placar, 3); }
+        else if (opc == 5) {
+            if (salvarInvestigacao(inv, m, arqSalvamento) == 0)
+                SAIDA("Investigação salva em %s\n", arqSalvamento);
+            else
+                fprintf(stderr, "Erro ao salvar a investigação em %s\n", arqSalvamento);
+        }
+        else if (opc == 6) { if (!modoLote) relatarEstatisticas(stdout, ht, inv); }
+        else if (opc == 7) consultarPistas(inv);
+        else if (opc == 8) { if (!modoLote) listarAssociacoes(ht); }
+        else if (opc == 9) gerenciarRamos(m, inv, &g);
+        else if (opc == 0 || opc == OPCAO_FIM) break;
+        else SAIDA("Opção inválida\n");
+    }
+
+    for (int i = 0; i < g.n; i++)
+        if (i != g.ativo) liberarInvestigacao(&g.ramos[i]);
+    return opc == 0;
+}
+
+static void listarPistasNaLinha(PistaNode *r) {
+    CursorPistas c;
+    iniciarCursor(&c, r);
+    for (int p, primeira = 1; (p = proximaPista(&c)) != -1; primeira = 0)
+        printf("%s%s", primeira ? "" : "; ", textoInterno(p));
+}
+
+/* Resultado de uma sessão do lote numa única linha. */
+static void relatarSessao(long num, Investigacao *inv) {
+    printf("sessao %ld: pistas=[", num);
+    listarPistasNaLinha(inv->pistas);
+    printf("]");
+    if (inv->acusado == -1)
+        printf(" acusacao=nenhuma\n");
+    else
+        printf(" acusacao=%s evidencias=%d %s\n", textoInterno(inv->acusado),
+               evidenciasContra(&inv->placar, inv->acusado),
+               inv->acertou ? "CORRETA" : "FALSA");
+}
+
+void limparBuffer(void) {
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF);
+}
+
+/* ==========================
+   BENCHMARK
+   Mede as funções quentes sobre n chaves sintéticas. As operações são
+   cronometradas em lotes de BENCH_LOTE (as O(n) por chamada, uma a
+   uma); ns/op e percentis vêm da média de cada lote. Saída: uma linha
+   JSON por função.
+   Distribuições: "aleatoria" (ordem embaralhada), "ordenada" (ordem
+   crescente, pior caso de BST sem balanceamento) e "prefixo" (chaves
+   com um prefixo longo em comum, pior caso de strcmp).
+   ========================== */
+#define BENCH_LOTE 64
+
+static volatile unsigned long benchSink;
+
+static int compararDouble(const void *a, const void *b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+typedef struct Cronometro {
+    double *lotes;         /* ns/op de cada lote */
+    int nLotes;
+    long ops;
+    double total;          /* ns */
+} Cronometro;
+
+static void iniciarCronometro(Cronometro *c, long ops, int lote) {
+    c->lotes = malloc(((ops + lote - 1) / lote + 1) * sizeof(double));
+    if (!c->lotes) exit(1);
+    c->nLotes = 0;
+    c->ops = 0;
+    c->total = 0;
+}
+
+static void registrarLote(Cronometro *c, double ns, int ops) {
+    c->lotes[c->nLotes++] = ns / ops;
+    c->ops += ops;
+    c->total += ns;
+}
+
+static void relatarCronometro(Cronometro *c, const char *funcao, int n, const char *dist) {
+    qsort(c->lotes, c->nLotes, sizeof(double), compararDouble);
+    double p50 = c->lotes[c->nLotes * 50 / 100];
+    double p90 = c->lotes[c->nLotes * 90 / 100];
+    double p99 = c->lotes[c->nLotes * 99 / 100];
+    double nsOp = c->total / c->ops;
+    printf("{\"funcao\":\"%s\",\"n\":%d,\"dist\":\"%s\",\"ops\":%ld,"
+           "\"ns_op\":%.2f,\"ops_s\":%.0f,\"p50_ns\":%.2f,\"p90_ns\":%.2f,\"p99_ns\":%.2f}\n",
+           funcao, n, dist, c->ops, nsOp, 1e9 / nsOp, p50, p90, p99);
+    free(c->lotes);
+}
+
+/* Roda corpo(i) para i em [0, total), cronometrando lotes de lote. */
+#define BENCH_LACO_LOTE(c, total, lote, corpo) do {                \
+        iniciarCronometro(&(c), (total), (lote));                  \
+        for (long _b = 0; _b < (total); _b += (lote)) {            \
+            long _fim = _b + (lote) < (total) ? _b + (lote) : (total); \
+            double _t0 = agoraNs();                                \
+            for (long i = _b; i < _fim; i++) { corpo; }            \
+            registrarLote(&(c), agoraNs() - _t0, (int) (_fim - _b)); \
+        }                                                          \
+    } while (0)
+
+#define BENCH_LACO(c, total, corpo) BENCH_LACO_LOTE(c, total, BENCH_LOTE, corpo)
+
+#define BENCH_SUSPEITOS 256   /* suspeitos no teste de pontuarSuspeitos */
+
+static char** gerarChavesBench(int n, const char *dist) {
+    char **chaves = malloc(n * sizeof(char*));
+    if (!chaves) exit(1);
+    for (int i = 0; i < n; i++) {
+        char buf[160];
+        if (strcmp(dist, "prefixo") == 0)
+            snprintf(buf, sizeof buf, "Carta rasgada encontrada perto da lareira do salão, trecho %08d", i);
+        else
+            snprintf(buf, sizeof buf, "pista-%08d", i);
+        chaves[i] = malloc(strlen(buf) + 1);
+        if (!chaves[i]) exit(1);
+        strcpy(chaves[i], buf);
+    }
+    /* "ordenada" mantém a ordem crescente; as demais são embaralhadas */
+    if (strcmp(dist, "ordenada") != 0) {
+        srand(12345);
+        for (int i = n - 1; i > 0; i--) {
+            int j = (int) (((unsigned long) rand() * (RAND_MAX + 1UL) + rand()) % (i + 1));
+            char *t = chaves[i]; chaves[i] = chaves[j]; chaves[j] = t;
+        }
+    }
+    return chaves;
+}
+
+int executarBenchmark(int n, const char *dist) {
+    if (n <= 0 || (strcmp(dist, "aleatoria") != 0 && strcmp(dist, "ordenada") != 0 &&
+                   strcmp(dist, "prefixo") != 0)) {
+        fprintf(stderr, "Benchmark: n deve ser > 0 e dist aleatoria|ordenada|prefixo\n");
+        return 1;
+    }
+
+    const char *suspeitos[] = { "Dr. Silva", "Maria", "Capitão Rocha", "Mordomo" };
+    const int nSus = 4;
+    char **chaves = gerarChavesBench(n, dist);
+    int *ids = malloc(n * sizeof(int));
+    if (!ids) exit(1);
+    Cronometro c;
+
+    BENCH_LACO(c, n, benchSink += hashString(chaves[i]));
+    relatarCronometro(&c, "hashString", n, dist);
+
+    HashTable ht;
+    inicializarHash(&ht);
+    BENCH_LACO(c, n, inserirMapping(&ht, chaves[i], suspeitos[i % nSus]));
+    relatarCronometro(&c, "inserirMapping", n, dist);
+
+    BENCH_LACO(c, n, benchSink += (unsigned long) buscarSuspeitoPorPista(&ht, chaves[i]));
+    relatarCronometro(&c, "buscarSuspeitoPorPista", n, dist);
+
+    /* pistas do catálogo estático: numa tabela que o carregou a busca
+       para na hash perfeita; na outra, com os mesmos mapeamentos, vai
+       para a dinâmica */
+    if (CATALOGO_N > 0) {
+        HashTable hc, hd;
+        inicializarHash(&hc);
+        carregarCatalogoEstatico(&hc);
+        inicializarHash(&hd);
+        for (int k = 0; k < CATALOGO_N; k++) {
+            const CatalogoPista *cp = &CATALOGO_PISTAS[CATALOGO_ORDEM[k]];
+            inserirMapping(&hd, cp->pista, cp->suspeito);
+        }
+        BENCH_LACO(c, n, benchSink += (unsigned long) buscarSuspeitoPorPista(
+                             &hc, CATALOGO_PISTAS[CATALOGO_ORDEM[i % CATALOGO_N]].pista));
+        relatarCronometro(&c, "buscarSuspeitoPorPista/catalogo", n, dist);
+        BENCH_LACO(c, n, benchSink += (unsigned long) buscarSuspeitoPorPista(
+                             &hd, CATALOGO_PISTAS[CATALOGO_ORDEM[i % CATALOGO_N]].pista));
+        relatarCronometro(&c, "buscarSuspeitoPorPista/dinamica", n, dist);
+        liberarHash(&hc);
+        liberarHash(&hd);
+    }
+
+    for (int i = 0; i < n; i++) ids[i] = buscarIdInterno(chaves[i]);
+
+    Investigacao inv;
+    inicializarInvestigacao(&inv);
+    BENCH_LACO(c, n, benchSink += inserirOuEncontrar(arenaDaInvestigacao(&inv), &inv.pistas, ids[i]));
+    relatarCronometro(&c, "inserirPistaBST", n, dist);
+
+    PistaNode *versao = NULL;
+    BENCH_LACO(c, n, benchSink += inserirPersistente(arenaDaInvestigacao(&inv), &versao, ids[i]));
+    relatarCronometro(&c, "inserirPersistente", n, dist);
+
+    BENCH_LACO(c, n, benchSink += existePistaBST(inv.pistas, ids[i]));
+    relatarCronometro(&c, "existePistaBST", n, dist);
+
+    /* O(n) por chamada: cada uma é cronometrada sozinha, para os
+       percentis terem amostras, e as repetições diminuem com n */
+    int sus[4];
+    for (int k = 0; k < nSus; k++) sus[k] = buscarIdInterno(suspeitos[k]);
+    long reps = n >= 100000 ? 32 : 256;
+    BENCH_LACO_LOTE(c, reps, 1, benchSink += contarPistasAssociadas(inv.pistas, &ht, sus[i % nSus]));
+    relatarCronometro(&c, "contarPistasAssociadas", n, dist);
+
+    for (int i = 0; i < n; i++) {
+        int s = buscarSuspeitoId(&ht, ids[i]);
+        if (s != -1) registrarEvidencia(&inv.placar, s);
+    }
+    BENCH_LACO(c, n, benchSink += evidenciasContra(&inv.placar, sus[i % nSus]));
+    relatarCronometro(&c, "evidenciasContra", n, dist);
+
+    /* registro grande: as mesmas pistas espalhadas por BENCH_SUSPEITOS
+       suspeitos, com metade delas coletada */
+    HashTable hs;
+    inicializarHash(&hs);
+    char nome[32];
+    for (int i = 0; i < n; i++) {
+        snprintf(nome, sizeof nome, "Suspeito %d", i % BENCH_SUSPEITOS);
+        inserirMapping(&hs, chaves[i], nome);
+    }
+    Investigacao metade;
+    inicializarInvestigacao(&metade);
+    for (int i = 0; i < n; i += 2) creditarPista(&hs, &metade, ids[i]);
+    int *pontos = malloc(hs.nSuspeitos * sizeof(int));
+    if (!pontos) exit(1);
+    BENCH_LACO_LOTE(c, reps, 1, pontuarSuspeitos(&hs, &metade, pontos);
+                    benchSink += pontos[i % hs.nSuspeitos]);
+    relatarCronometro(&c, "pontuarSuspeitos", n, dist);
+    free(pontos);
+    liberarInvestigacao(&metade);
+    liberarHash(&hs);
+
+    liberarInvestigacao(&inv);
+    liberarHash(&ht);
+    for (int i = 0; i < n; i++) free(chaves[i]);
+    free(chaves);
+    free(ids);
+    return 0;
+}
+
+/* ==========================
+   GERADOR E TESTE DE ESCALA
+   Mansões e catálogos sintéticos, os mesmos para a mesma semente.
+   Formas: "balanceada" (altura ~log2 n), "torta" (cada subárvore
+   direita fica com no máximo 1/8 do que sobra, o resto vai para a
+   esquerda) e "corrente" (só filhos esquerdos: altura n). Suspeitos
+   das pistas: "uniforme" ou "zipf" (o k-ésimo tem peso 1/k).
+   O teste de escala joga sessões completas (explorar + acusar) com
+   escolhas aleatórias e relata uma linha JSON por fase.
+   ========================== */
+#define MUNDO_SEM_PISTA 4      /* 1 sala em cada MUNDO_SEM_PISTA fica sem pista */
+#define ESCALA_SESSOES 100     /* sessões do teste de escala, por padrão */
+
+/* splitmix64: o mesmo fluxo em qualquer libc, ao contrário de rand() */
+static uint64_t proximoAleatorio(uint64_t *estado) {
+    uint64_t z = (*estado += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static int mundoValido(const Mundo *w) {
+    if (w->nSalas <= 0 || w->nPistas < 0 || w->nSuspeitos <= 0 ||
+        (strcmp(w->forma, "balanceada") != 0 && strcmp(w->forma, "torta") != 0 &&
+         strcmp(w->forma, "corrente") != 0) ||
+        (strcmp(w->dist, "uniforme") != 0 && strcmp(w->dist, "zipf") != 0)) {
+        fprintf(stderr, "Mundo: N > 0, FORMA balanceada|torta|corrente, M >= 0, S > 0"
+                        " e DIST uniforme|zipf\n");
+        return 0;
+    }
+    return 1;
+}
+
+/* Catálogo: pistas[i] e suspeitoDe[i] são ids internados. */
+static void gerarCatalogoSintetico(const Mundo *w, uint64_t *rng, int *pistas, int *suspeitoDe) {
+    char buf[32];
+    int *suspeitos = malloc(w->nSuspeitos * sizeof(int));
+    double *acumulado = malloc(w->nSuspeitos * sizeof(double));
+    if (!suspeitos || !acumulado) exit(1);
+
+    double soma = 0;
+    int zipf = strcmp(w->dist, "zipf") == 0;
+    for (int k = 0; k < w->nSuspeitos; k++) {
+        snprintf(buf, sizeof buf, "Suspeito %d", k + 1);
+        suspeitos[k] = internar(buf);
+        acumulado[k] = soma += zipf ? 1.0 / (k + 1) : 1.0;
+    }
+
+    for (int i = 0; i < w->nPistas; i++) {
+        snprintf(buf, sizeof buf, "Pista %d", i + 1);
+        pistas[i] = internar(buf);
+        /* busca binária na distribuição acumulada */
+        double u = (proximoAleatorio(rng) >> 11) * 0x1.0p-53 * soma;
+        int lo = 0, hi = w->nSuspeitos - 1;
+        while (lo < hi) {
+            int meio = (lo + hi) / 2;
+            if (acumulado[meio] > u) hi = meio;
+            else lo = meio + 1;
+        }
+        suspeitoDe[i] = suspeitos[lo];
+    }
+    free(suspeitos);
+    free(acumulado);
+}
+
+/* Monta a mansão direto em pré-ordem: a subárvore esquerda de uma sala
+   ocupa os índices logo após ela e a direita vem em seguida, então
+   basta decidir o tamanho de cada uma. A última sala (sempre folha em
+   pré-ordem) é a Saída. */
+static void gerarMansaoSintetica(Arena *a, MansaoPlana *m, const Mundo *w, uint64_t *rng,
+                                 const int *pistas) {
+    typedef struct { int sala, tam; } Subarvore;
+    int n = w->nSalas;
+    int idSaida = internar("Saída");
+    alocarMansaoPlana(a, m, n);
+
+    Subarvore *pilha = malloc(n * sizeof(Subarvore));
+    if (!pilha) exit(1);
+    int topo = 0;
+    pilha[topo++] = (Subarvore) { 0, n };
+    while (topo > 0) {
+        Subarvore sub = pilha[--topo];
+        int resto = sub.tam - 1, esq;
+        if (w->forma[0] == 'b') esq = (resto + 1) / 2;
+        else if (w->forma[0] == 'c') esq = resto;
+        else esq = resto - (int) (proximoAleatorio(rng) % (resto / 8 + 1));
+        int dir = resto - esq;
+
+        m->salas[sub.sala].esq = esq ? sub.sala + 1 : -1;
+        m->salas[sub.sala].dir = dir ? sub.sala + 1 + esq : -1;
+        if (dir) pilha[topo++] = (Subarvore) { sub.sala + 1 + esq, dir };
+        if (esq) pilha[topo++] = (Subarvore) { sub.sala + 1, esq };
+    }
+    free(pilha);
+
+    char buf[32];
+    for (int i = 0; i < n; i++) {
+        if (i == 0) m->nomes[i] = internar("Hall de Entrada");
+        else if (i == n - 1) m->nomes[i] = idSaida;
+        else {
+            snprintf(buf, sizeof buf, "Sala %d", i);
+            m->nomes[i] = internar(buf);
+        }
+        int semPista = w->nPistas == 0 || proximoAleatorio(rng) % MUNDO_SEM_PISTA == 0;
+        m->salas[i].pista = semPista ? SEM_PISTA : pistas[proximoAleatorio(rng) % w->nPistas];
+    }
+}
+
+/* Catálogo e mansão da semente; pistas e suspeitoDe são do chamador. */
+static void gerarMundo(const Mundo *w, Arena *a, MansaoPlana *m, int **pistas, int **suspeitoDe) {
+    uint64_t rng = w->semente;
+    *pistas = malloc((w->nPistas ? w->nPistas : 1) * sizeof(int));
+    *suspeitoDe = malloc((w->nPistas ? w->nPistas : 1) * sizeof(int));
+    if (!*pistas || !*suspeitoDe) exit(1);
+    gerarCatalogoSintetico(w, &rng, *pistas, *suspeitoDe);
+    gerarMansaoSintetica(a, m, w, &rng, *pistas);
+}
+
+/* Grava PREFIXO.dqm e PREFIXO-catalogo.txt, para usar depois com
+   --mansao e --catalogo. */
+int gerarArquivosMundo(const Mundo *w, const char *prefixo) {
+    if (!mundoValido(w)) return 1;
+    Arena a;
+    inicializarArena(&a);
+    MansaoPlana m;
+    int *pistas, *suspeitoDe;
+    gerarMundo(w, &a, &m, &pistas, &suspeitoDe);
+
+    char caminho[4096];
+    snprintf(caminho, sizeof caminho, "%s.dqm", prefixo);
+    int erro = salvarMansao(&m, caminho) != 0;
+    if (erro) fprintf(stderr, "Erro ao gravar a mansão em %s\n", caminho);
+
+    snprintf(caminho, sizeof caminho, "%s-catalogo.txt", prefixo);
+    FILE *f = erro ? NULL : fopen(caminho, "w");
+    if (f) {
+        setvbuf(f, NULL, _IOFBF, 1 << 16);
+        fprintf(f, "# gerado: %d salas %s, %d pistas, %d suspeitos %s, semente %llu\n",
+                w->nSalas, w->forma, w->nPistas, w->nSuspeitos, w->dist,
+                (unsigned long long) w->semente);
+        for (int i = 0; i < w->nPistas; i++)
+            fprintf(f, "%s;%s\n", textoInterno(pistas[i]), textoInterno(suspeitoDe[i]));
+        if (ferror(f)) erro = 1;
+        if (fclose(f) != 0) erro = 1;
+        if (erro) fprintf(stderr, "Erro ao gravar o catálogo em %s\n", caminho);
+    } else if (!erro) {
+        fprintf(stderr, "Erro ao gravar o catálogo em %s\n", caminho);
+        erro = 1;
+    }
+
+    free(pistas);
+    free(suspeitoDe);
+    liberarArena(&a);
+    return erro;
+}
+
+static void relatarFase(const char *fase, long ops, double ns) {
+    printf("{\"fase\":\"%s\",\"ops\":%ld,\"ms\":%.3f,\"ops_s\":%.0f}\n",
+           fase, ops, ns / 1e6, ns > 0 ? ops * 1e9 / ns : 0.0);
+}
+
+/* Gera o mundo, carrega o catálogo na hash e joga as sessões: cada uma
+   anda da entrada até o fim da exploração escolhendo um caminho ao
+   acaso e acusa o primeiro do placar. */
+int executarEscala(const Mundo *w, int sessoes) {
+    if (!mundoValido(w) || sessoes < 0) return 1;
+    double t0 = agoraNs();
+
+    Arena a;
+    inicializarArena(&a);
+    MansaoPlana m;
+    int *pistas, *suspeitoDe;
+    gerarMundo(w, &a, &m, &pistas, &suspeitoDe);
+    double t1 = agoraNs();
+    relatarFase("gerar", (long) w->nSalas + w->nPistas, t1 - t0);
+
+    HashTable ht;
+    inicializarHash(&ht);
+    for (int i = 0; i < w->nPistas; i++)
+        inserirMapping(&ht, textoInterno(pistas[i]), textoInterno(suspeitoDe[i]));
+    double t2 = agoraNs();
+    relatarFase("catalogo", w->nPistas, t2 - t1);
+
+    uint64_t rng = w->semente ^ 0x5e55a0ULL;
+    long visitas = 0, coletadas = 0, acertos = 0;
+    for (int s = 0; s < sessoes; s++) {
+        Investigacao inv;
+        inicializarInvestigacao(&inv);
+        int at = 0;
+        while (1) {
+            visitarSala(&m, &ht, &inv, at);
+            visitas++;
+            if (fimDaExploracao(&m, at)) break;
+            const SalaQuente *sala = &m.salas[at];
+            if (sala->esq == -1) at = sala->dir;
+            else if (sala->dir == -1) at = sala->esq;
+            else at = proximoAleatorio(&rng) & 1 ? sala->dir : sala->esq;
+        }
+        int top;
+        if (topSuspeitos(&inv.placar, 1, &top) == 1) {
+            acusar(&ht, &inv, top);
+            acertos += inv.acertou;
+        }
+        coletadas += contarNos(inv.pistas);
+        liberarInvestigacao(&inv);
+    }
+    double t3 = agoraNs();
+    relatarFase("sessoes", sessoes, t3 - t2);
+    relatarFase("salas_visitadas", visitas, t3 - t2);
+
+    struct rusage uso;
+    getrusage(RUSAGE_SELF, &uso);
+    printf("{\"salas\":%d,\"forma\":\"%s\",\"pistas\":%d,\"suspeitos\":%d,\"dist\":\"%s\","
+           "\"semente\":%llu,\"sessoes\":%d,\"pistas_coletadas\":%ld,\"acertos\":%ld,"
+           "\"total_ms\":%.3f,\"pico_rss_kib\":%ld}\n",
+           w->nSalas, w->forma, w->nPistas, w->nSuspeitos, w->dist,
+           (unsigned long long) w->semente, sessoes, coletadas, acertos,
+           (t3 - t0) / 1e6, uso.ru_maxrss);
+
+    liberarHash(&ht);
+    free(pistas);
+    free(suspeitoDe);
+    liberarArena(&a);
+    return 0;
+}
+
+/* ==========================
+   RESOLVEDOR DE CAMINHOS
+   Enumera todos os caminhos da entrada até o fim de uma exploração
+   (Saída ou cômodo sem caminhos) e, para cada um, verifica quais
+   suspeitos teriam a acusação considerada correta (cont >= 2, como em
+   acusar). Pistas repetidas no mesmo caminho contam uma vez só.
+
+   Paralelismo por roubo de trabalho: cada thread tem um deque de
+   subárvores; desce pela esquerda e empilha o filho direito no próprio
+   deque quando ele é grande (>= RESOLVER_CORTE salas), processando
+   subárvores pequenas ali mesmo. Threads ociosas roubam a subárvore
+   mais antiga (mais alta) de outra. Uma tarefa é só o índice da sala:
+   quem a executa reconstrói as pistas do caminho subindo por pai[].
+   ========================== */
+#define RESOLVER_CORTE 4096
+
+typedef struct DequeTarefas {
+    pthread_mutex_t trava;
+    int *itens;
+    int topo, fundo, cap;  /* itens válidos em [topo, fundo) */
+} DequeTarefas;
+
+typedef struct Resolvedor {
+    const MansaoPlana *m;
+    const int *pai;
+    const int *tamanho;     /* nº de salas da subárvore */
+    const int *pistaDensa;  /* sala -> pista com suspeito (0..nPistas-1) ou -1 */
+    const int *suspeitoDe;  /* pista densa -> suspeito denso */
+    int nPistas, nSuspeitos, nThreads;
+    DequeTarefas *deques;
+    long pendentes;         /* tarefas criadas e ainda não concluídas */
+} Resolvedor;
+
+typedef struct EstadoResolvedor {
+    Resolvedor *r;
+    int id;
+    unsigned int semente;
+    int *vistas;            /* pista densa -> ocorrências no caminho atual */
+    int *cont;              /* suspeito -> pistas distintas no caminho */
+    int *resolvidos;        /* suspeitos com cont >= 2, sem ordem */
+    int *posResolvido;      /* suspeito -> posição em resolvidos, -1 = fora */
+    int nResolvidos;
+    long caminhos, semSolucao, solucaoUnica;
+    long *caminhosSuspeito; /* caminhos em que o suspeito seria culpado */
+    int *maxEvidencias;
+    int *pilha;
+    int capPilha;
+} EstadoResolvedor;
+
+static void empilharTarefa(Resolvedor *r, int dono, int sala) {
+    DequeTarefas *d = &r->deques[dono];
+    __atomic_fetch_add(&r->pendentes, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&d->trava);
+    if (d->fundo == d->cap) {
+        if (d->topo > 0) {
+            memmove(d->itens, d->itens + d->topo, (d->fundo - d->topo) * sizeof(int));
+            d->fundo -= d->topo;
+            d->topo = 0;
+        } else {
+            d->cap = d->cap ? d->cap * 2 : 64;
+            d->itens = realloc(d->itens, d->cap * sizeof(int));
+            if (!d->itens) exit(1);
+        }
+    }
+    d->itens[d->fundo++] = sala;
+    pthread_mutex_unlock(&d->trava);
+}
+
+/* O dono tira do fundo (a tarefa mais recente); ladrões, do topo. */
+static int retirarTarefa(DequeTarefas *d, int doFundo) {
+    int sala = -1;
+    pthread_mutex_lock(&d->trava);
+    if (d->topo < d->fundo)
+        sala = doFundo ? d->itens[--d->fundo] : d->itens[d->topo++];
+    if (d->topo == d->fundo) d->topo = d->fundo = 0;
+    pthread_mutex_unlock(&d->trava);
+    return sala;
+}
+
+static void aplicarPista(EstadoResolvedor *e, int sala, int delta) {
+    int p = e->r->pistaDensa[sala];
+    if (p == -1) return;
+    if (delta > 0 ? e->vistas[p]++ != 0 : --e->vistas[p] != 0) return;
+
+    int s = e->r->suspeitoDe[p];
+    int antes = e->cont[s];
+    e->cont[s] += delta;
+    if (e->cont[s] > e->maxEvidencias[s]) e->maxEvidencias[s] = e->cont[s];
+
+    if (antes < 2 && e->cont[s] >= 2) {
+        e->posResolvido[s] = e->nResolvidos;
+        e->resolvidos[e->nResolvidos++] = s;
+    } else if (antes >= 2 && e->cont[s] < 2) {
+        int i = e->posResolvido[s], ult = e->resolvidos[--e->nResolvidos];
+        e->resolvidos[i] = ult;
+        e->posResolvido[ult] = i;
+        e->posResolvido[s] = -1;
+    }
+}
+
+static void pontuarCaminho(EstadoResolvedor *e) {
+    e->caminhos++;
+    if (e->nResolvidos == 0) e->semSolucao++;
+    else if (e->nResolvidos == 1) e->solucaoUnica++;
+    for (int i = 0; i < e->nResolvidos; i++)
+        e->caminhosSuspeito[e->resolvidos[i]]++;
+}
+
+/* Percorre a subárvore de raiz com pilha explícita. Cada sala entra na
+   pilha duas vezes: codificada como ~sala para desfazer sua pista. */
+static void executarTarefa(EstadoResolvedor *e, int raiz) {
+    Resolvedor *r = e->r;
+    const SalaQuente *salas = r->m->salas;
+
+    for (int a = r->pai[raiz]; a != -1; a = r->pai[a])
+        aplicarPista(e, a, +1);
+
+    int topo = 0;
+    e->pilha[topo++] = raiz;
+    while (topo > 0) {
+        int x = e->pilha[--topo];
+        if (x < 0) {
+            aplicarPista(e, ~x, -1);
+            continue;
+        }
+        aplicarPista(e, x, +1);
+        if (fimDaExploracao(r->m, x)) {
+            pontuarCaminho(e);
+            aplicarPista(e, x, -1);
+            continue;
+        }
+
+        if (topo + 3 > e->capPilha) {
+            e->capPilha *= 2;
+            e->pilha = realloc(e->pilha, e->capPilha * sizeof(int));
+            if (!e->pilha) exit(1);
+        }
+        e->pilha[topo++] = ~x;
+        int esq = salas[x].esq, dir = salas[x].dir;
+        if (dir != -1) {
+            if (r->tamanho[dir] >= RESOLVER_CORTE) empilharTarefa(r, e->id, dir);
+            else e->pilha[topo++] = dir;
+        }
+        if (esq != -1) e->pilha[topo++] = esq;
+    }
+
+    for (int a = r->pai[raiz]; a != -1; a = r->pai[a])
+        aplicarPista(e, a, -1);
+}
+
+static void* workerResolvedor(void *arg) {
+    EstadoResolvedor *e = arg;
+    Resolvedor *r = e->r;
+
+    for (;;) {
+        int sala = retirarTarefa(&r->deques[e->id], 1);
+        for (int t = 0; sala == -1 && t < 2 * r->nThreads; t++) {
+            int vitima = rand_r(&e->semente) % r->nThreads;
+            if (vitima != e->id) sala = retirarTarefa(&r->deques[vitima], 0);
+        }
+        if (sala == -1) {
+            if (__atomic_load_n(&r->pendentes, __ATOMIC_SEQ_CST) == 0) return NULL;
+            sched_yield();
+            continue;
+        }
+        executarTarefa(e, sala);
+        __atomic_fetch_sub(&r->pendentes, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+/* Imprime estatísticas de solubilidade por suspeito. */
+int resolverMansao(const MansaoPlana *m, HashTable *ht, int nThreads) {
+    double t0 = agoraNs();
+    int n = m->n;
+    if (nThreads <= 0) nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nThreads <= 0) nThreads = 1;
+
+    /* pai[] e ordem de visita (pais antes dos filhos) */
+    int *pai = malloc(n * sizeof(int));
+    int *ordem = malloc(n * sizeof(int));
+    int *tamanho = malloc(n * sizeof(int));
+    int *pistaDensa = malloc(n * sizeof(int));
+    int *densaDeId = malloc((internos.total ? internos.total : 1) * sizeof(int));
+    int *suspDeId = malloc((internos.total ? internos.total : 1) * sizeof(int));
+    int *suspeitoDe = malloc((n ? n : 1) * sizeof(int));
+    int *idSuspeito = malloc((n ? n : 1) * sizeof(int));
+    if (!pai || !ordem || !tamanho || !pistaDensa || !densaDeId || !suspDeId ||
+        !suspeitoDe || !idSuspeito)
+        exit(1);
+    for (int i = 0; i < n; i++) pai[i] = -2;
+    for (int i = 0; i < internos.total; i++) densaDeId[i] = suspDeId[i] = -1;
+
+    int nOrdem = 0;
+    pai[0] = -1;
+    ordem[nOrdem++] = 0;
+    for (int k = 0; k < nOrdem; k++) {
+        int x = ordem[k];
+        int filhos[2] = { m->salas[x].esq, m->salas[x].dir };
+        for (int j = 0; j < 2; j++) {
+            int f = filhos[j];
+            if (f == -1) continue;
+            if (pai[f] != -2) {
+                fprintf(stderr, "Resolvedor: a mansão não é uma árvore (sala %d)\n", f);
+                free(pai); free(ordem); free(tamanho); free(pistaDensa);
+                free(densaDeId); free(suspDeId); free(suspeitoDe); free(idSuspeito);
+                return 1;
+            }
+            pai[f] = x;
+            ordem[nOrdem++] = f;
+        }
+    }
+    for (int k = nOrdem - 1; k >= 0; k--) {
+        int x = ordem[k];
+        tamanho[x] = 1;
+        if (m->salas[x].esq != -1) tamanho[x] += tamanho[m->salas[x].esq];
+        if (m->salas[x].dir != -1) tamanho[x] += tamanho[m->salas[x].dir];
+    }
+
+    /* pistas e suspeitos com índices densos, consultando a hash uma vez */
+    int nPistas = 0, nSuspeitos = 0;
+    for (int i = 0; i < n; i++) {
+        int p = m->salas[i].pista;
+        pistaDensa[i] = -1;
+        if (p == SEM_PISTA) continue;
+        if (densaDeId[p] == -1) {
+            int sus = buscarSuspeitoId(ht, p);
+            if (sus == -1) continue;
+            if (suspDeId[sus] == -1) {
+                idSuspeito[nSuspeitos] = sus;
+                suspDeId[sus] = nSuspeitos++;
+            }
+            suspeitoDe[nPistas] = suspDeId[sus];
+            densaDeId[p] = nPistas++;
+        }
+        pistaDensa[i] = densaDeId[p];
+    }
+
+    Resolvedor r;
+    r.m = m;
+    r.pai = pai;
+    r.tamanho = tamanho;
+    r.pistaDensa = pistaDensa;
+    r.suspeitoDe = suspeitoDe;
+    r.nPistas = nPistas;
+    r.nSuspeitos = nSuspeitos;
+    r.nThreads = nThreads;
+    r.pendentes = 0;
+    r.deques = calloc(nThreads, sizeof(DequeTarefas));
+    EstadoResolvedor *est = calloc(nThreads, sizeof(EstadoResolvedor));
+    pthread_t *th = malloc(nThreads * sizeof(pthread_t));
+    if (!r.deques || !est || !th) exit(1);
+
+    int ns = nSuspeitos ? nSuspeitos : 1;
+    for (int t = 0; t < nThreads; t++) {
+        pthread_mutex_init(&r.deques[t].trava, NULL);
+        EstadoResolvedor *e = &est[t];
+        e->r = &r;
+        e->id = t;
+        e->semente = 0x9e3779b9u * (t + 1);
+        e->vistas = calloc(nPistas ? nPistas : 1, sizeof(int));
+        e->cont = calloc(ns, sizeof(int));
+        e->resolvidos = calloc(ns, sizeof(int));
+        e->posResolvido = malloc(ns * sizeof(int));
+        e->caminhosSuspeito = calloc(ns, sizeof(long));
+        e->maxEvidencias = calloc(ns, sizeof(int));
+        e->capPilha = 1024;
+        e->pilha = malloc(e->capPilha * sizeof(int));
+        if (!e->vistas || !e->cont || !e->resolvidos || !e->posResolvido ||
+            !e->caminhosSuspeito || !e->maxEvidencias || !e->pilha)
+            exit(1);
+        for (int s = 0; s < ns; s++) e->posResolvido[s] = -1;
+    }
+
+    empilharTarefa(&r, 0, 0);
+    for (int t = 0; t < nThreads; t++)
+        pthread_create(&th[t], NULL, workerResolvedor, &est[t]);
+    for (int t = 0; t < nThreads; t++)
+        pthread_join(th[t], NULL);
+
+    /* soma os resultados das threads na thread 0 */
+    EstadoResolvedor *tot = &est[0];
+    for (int t = 1; t < nThreads; t++) {
+        tot->caminhos += est[t].caminhos;
+        tot->semSolucao += est[t].semSolucao;
+        tot->solucaoUnica += est[t].solucaoUnica;
+        for (int s = 0; s < nSuspeitos; s++) {
+            tot->caminhosSuspeito[s] += est[t].caminhosSuspeito[s];
+            if (est[t].maxEvidencias[s] > tot->maxEvidencias[s])
+                tot->maxEvidencias[s] = est[t].maxEvidencias[s];
+        }
+    }
+
+    double ms = (agoraNs() - t0) / 1e6;
+    printf("Salas: %d | pistas com suspeito: %d | suspeitos: %d\n", n, nPistas, nSuspeitos);
+    printf("Caminhos analisados: %ld (%.1f ms, %d threads)\n", tot->caminhos, ms, nThreads);
+    printf("Caminhos sem acusação correta possível: %ld\n", tot->semSolucao);
+    printf("Caminhos com um único culpado possível: %ld\n", tot->solucaoUnica);
+    printf("%-24s %14s %8s %10s\n", "Suspeito", "Resolvíveis", "%", "Máx. pistas");
+    for (int s = 0; s < nSuspeitos; s++)
+        printf("%-24s %14ld %7.2f%% %10d\n", textoInterno(idSuspeito[s]), tot->caminhosSuspeito[s],
+               tot->caminhos ? 100.0 * tot->caminhosSuspeito[s] / tot->caminhos : 0.0,
+               tot->maxEvidencias[s]);
+
+    for (int t = 0; t < nThreads; t++) {
+        EstadoResolvedor *e = &est[t];
+        free(e->vistas); free(e->cont); free(e->resolvidos); free(e->posResolvido);
+        free(e->caminhosSuspeito); free(e->maxEvidencias); free(e->pilha);
+        free(r.deques[t].itens);
+        pthread_mutex_destroy(&r.deques[t].trava);
+    }
+    free(est); free(th); free(r.deques);
+    free(pai); free(ordem); free(tamanho); free(pistaDensa);
+    free(densaDeId); free(suspDeId); free(suspeitoDe); free(idSuspeito);
+    return 0;
+}
+
+/* ==========================
+   SERVIDOR
+   Várias investigações num só processo. A mansão, a hash e o pool de
+   strings (e o catálogo mapeado, com --catalogo) são montados uma vez,
+   congelados e lidos por todas as threads; cada conexão tem só a sua Investigacao (cursor, BST e
+   placar).
+
+   Uma thread roda o laço epoll (aceita conexões e detecta dados) e
+   entrega conexões prontas a um pool de workers. Cada conexão é
+   registrada com EPOLLONESHOT, então no máximo um worker a atende por
+   vez e o estado da sessão dispensa travas.
+
+   Protocolo por linhas: o cliente envia as mesmas opções numéricas do
+   jogo interativo e recebe respostas curtas, sem prompts:
+     SALA <nome> | PISTA <texto> | SUSPEITO <nome> | FIM
+     ACUSAR? | ACUSACAO <nome> <n> CORRETA|FALSA | CANCELADO
+     PISTAS <a; b; ...> | TOP <nome>=<n>; ... | SEM PISTAS | INVALIDO | TCHAU
+   ========================== */
+#ifdef __linux__
+
+#define SERV_LINHA 256
+#define SERV_MAX_EVENTOS 256
+#define SERV_ENTRADA 4096
+#define SERV_SAIDA_MAX (64 * 1024) /* saída pendente a partir da qual a conexão para de ler */
+
+enum { ESTADO_MENU, ESTADO_EXPLORANDO, ESTADO_ACUSANDO };
+
+typedef struct BufferSaida {
+    char *dados;
+    size_t tam, cap, enviado;
+} BufferSaida;
+
+typedef struct Conexao {
+    int fd;
+    int estado;
+    int encerrar;          /* fecha depois de esvaziar a saída */
+    Investigacao inv;
+    char linha[SERV_LINHA];
+    int tamLinha;          /* -1 = descartando linha longa demais */
+    char entrada[SERV_ENTRADA]; /* recebido e ainda não processado */
+    int iniEntrada, fimEntrada;
+    BufferSaida saida;
+    struct Conexao *proxFila;
+    struct Conexao *ant, *prox; /* lista das abertas, para fechar no fim */
+} Conexao;
+
+typedef struct Servidor {
+    const MansaoPlana *m;
+    HashTable *ht;
+    const TabelaConcorrente *catalogo; /* --catalogo mapeado; NULL = sem */
+    int epfd;
+    int escuta;
+
+    pthread_mutex_t trava;
+    pthread_cond_t temTrabalho;
+    Conexao *filaIni, *filaFim;
+    int parar;
+    Conexao *abertas;      /* protegida por trava */
+    long ativas;
+    int escutaPausada;     /* 1 = escuta fora do epoll (faltaram fds) */
+} Servidor;
+
+static volatile sig_atomic_t pararServidor = 0;
+
+static void tratarSinalServidor(int sig) {
+    (void) sig;
+    pararServidor = 1;
+}
+
+static void anexarSaida(BufferSaida *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void anexarSaida(BufferSaida *b, const char *fmt, ...) {
+    va_list ap;
+    for (;;) {
+        size_t livre = b->cap - b->tam;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->dados ? b->dados + b->tam : NULL, livre, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t) n < livre) {
+            b->tam += n;
+            return;
+        }
+        size_t nova = b->cap ? b->cap * 2 : 256;
+        while (nova < b->tam + n + 1) nova *= 2;
+        b->dados = realloc(b->dados, nova);
+        if (!b->dados) exit(1);
+        b->cap = nova;
+    }
+}
+
+static void anexarPistas(BufferSaida *b, PistaNode *r) {
+    CursorPistas c;
+    iniciarCursor(&c, r);
+    for (int p, primeira = 1; (p = proximaPista(&c)) != -1; primeira = 0)
+        anexarSaida(b, "%s%s", primeira ? "" : "; ", textoInterno(p));
+}
+
+static void entrarNaSalaRemota(Servidor *sv, Conexao *c, int sala) {
+    int sus = visitarSala(sv->m, sv->ht, &c->inv, sala);
+    anexarSaida(&c->saida, "SALA %s\n", textoInterno(sv->m->nomes[sala]));
+    if (sv->m->salas[sala].pista != SEM_PISTA)
+        anexarSaida(&c->saida, "PISTA %s\n", textoInterno(sv->m->salas[sala].pista));
+    if (sus != -1) {
+        /* com catálogo, o nome sai da visão sobre o arquivo mapeado */
+        int p = sv->m->salas[sala].pista;
+        size_t ns = 0;
+        const char *nome = sv->catalogo
+            ? buscarSuspeitoConcorrente(sv->catalogo, textoInterno(p), comprimentoInterno(p),
+                                        internos.hashes[p], &ns)
+            : NULL;
+        if (nome) anexarSaida(&c->saida, "SUSPEITO %.*s\n", (int) ns, nome);
+        else anexarSaida(&c->saida, "SUSPEITO %s\n", textoInterno(sus));
+    }
+    if (fimDaExploracao(sv->m, sala)) {
+        anexarSaida(&c->saida, "FIM\n");
+        c->estado = ESTADO_ACUSANDO;
+        anexarSaida(&c->saida, "ACUSAR?\n");
+    }
+}
+
+/* Máquina de estados equivalente a jogarSessao/explorar/fazerAcusacao. */
+static void processarOpcaoRemota(Servidor *sv, Conexao *c, int op) {
+    Investigacao *inv = &c->inv;
+    const SalaQuente *sala = &sv->m->salas[inv->salaAtual];
+
+    switch (c->estado) {
+    case ESTADO_MENU:
+        if (op == 1) {
+            c->estado = ESTADO_EXPLORANDO;
+            entrarNaSalaRemota(sv, c, 0);
+        } else if (op == 2) {
+            anexarSaida(&c->saida, "PISTAS ");
+            anexarPistas(&c->saida, inv->pistas);
+            anexarSaida(&c->saida, "\n");
+        } else if (op == 3) {
+            if (!inv->pistas) {
+                anexarSaida(&c->saida, "SEM PISTAS\n");
+            } else {
+                c->estado = ESTADO_ACUSANDO;
+                anexarSaida(&c->saida, "ACUSAR?\n");
+            }
+        } else if (op == 4) {
+            int top[3], n = topSuspeitos(&inv->placar, 3, top);
+            anexarSaida(&c->saida, "TOP");
+            for (int i = 0; i < n; i++)
+                anexarSaida(&c->saida, "%s%s=%d", i ? "; " : " ", textoInterno(top[i]),
+                            evidenciasContra(&inv->placar, top[i]));
+            anexarSaida(&c->saida, "\n");
+        } else if (op == 0) {
+            anexarSaida(&c->saida, "TCHAU\n");
+            c->encerrar = 1;
+        } else {
+            anexarSaida(&c->saida, "INVALIDO\n");
+        }
+        break;
+
+    case ESTADO_EXPLORANDO:
+        if (op == 1 && sala->esq != -1) entrarNaSalaRemota(sv, c, sala->esq);
+        else if (op == 2 && sala->dir != -1) entrarNaSalaRemota(sv, c, sala->dir);
+        else if (op == 3) { c->estado = ESTADO_MENU; anexarSaida(&c->saida, "MENU\n"); }
+        else anexarSaida(&c->saida, "INVALIDO\n");
+        break;
+
+    case ESTADO_ACUSANDO:
+        c->estado = ESTADO_MENU;
+        if (!inv->pistas || op < 1 || op > sv->ht->nSuspeitos) {
+            anexarSaida(&c->saida, "CANCELADO\n");
+            break;
+        }
+        const char *nome = textoInterno(sv->ht->suspeitos[op - 1]);
+        int cont = acusar(sv->ht, inv, sv->ht->suspeitos[op - 1]);
+        anexarSaida(&c->saida, "ACUSACAO %s %d %s\n", nome, cont,
+                    inv->acertou ? "CORRETA" : "FALSA");
+        break;
+    }
+}
+
+static void processarLinhaRemota(Servidor *sv, Conexao *c) {
+    c->linha[c->tamLinha] = '\0';
+    char *fim;
+    long op = strtol(c->linha, &fim, 10);
+    while (*fim == ' ' || *fim == '\r' || *fim == '\t') fim++;
+    if (fim == c->linha || *fim != '\0')
+        anexarSaida(&c->saida, "INVALIDO\n");
+    else
+        processarOpcaoRemota(sv, c, (int) op);
+}
+
+/* Envia o que couber sem bloquear. Retorna -1 se a conexão caiu. */
+static int enviarPendente(Conexao *c) {
+    BufferSaida *b = &c->saida;
+    while (b->enviado < b->tam) {
+        ssize_t n = send(c->fd, b->dados + b->enviado, b->tam - b->enviado, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        b->enviado += n;
+    }
+    b->tam = b->enviado = 0;
+    return 0;
+}
+
+/* Devolve o socket de escuta ao epoll se ele foi pausado por falta de
+   descritores. Chamada quando um fd é liberado ou o laço fica ocioso. */
+static void retomarEscuta(Servidor *sv) {
+    if (!__atomic_exchange_n(&sv->escutaPausada, 0, __ATOMIC_RELAXED)) return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(sv->epfd, EPOLL_CTL_MOD, sv->escuta, &ev);
+}
+
+static void fecharConexao(Servidor *sv, Conexao *c) {
+    epoll_ctl(sv->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    liberarInvestigacao(&c->inv);
+    free(c->saida.dados);
+
+    pthread_mutex_lock(&sv->trava);
+    if (c->ant) c->ant->prox = c->prox;
+    else sv->abertas = c->prox;
+    if (c->prox) c->prox->ant = c->ant;
+    sv->ativas--;
+    pthread_mutex_unlock(&sv->trava);
+    free(c);
+    retomarEscuta(sv);
+}
+
+static size_t saidaPendente(const Conexao *c) {
+    return c->saida.tam - c->saida.enviado;
+}
+
+/* Processa o que já foi recebido, linha a linha, enquanto a saída
+   pendente couber em SERV_SAIDA_MAX; o resto espera em entrada. */
+static void consumirEntrada(Servidor *sv, Conexao *c) {
+    while (c->iniEntrada < c->fimEntrada && !c->encerrar &&
+           saidaPendente(c) < SERV_SAIDA_MAX) {
+        char ch = c->entrada[c->iniEntrada++];
+        if (ch == '\n') {
+            if (c->tamLinha >= 0) processarLinhaRemota(sv, c);
+            else anexarSaida(&c->saida, "INVALIDO\n");
+            c->tamLinha = 0;
+        } else if (c->tamLinha >= 0) {
+            if (c->tamLinha < SERV_LINHA - 1) c->linha[c->tamLinha++] = ch;
+            else c->tamLinha = -1;
+        }
+    }
+}
+
+/* Atende uma conexão pronta: lê, processa linhas completas, responde
+   e rearma o EPOLLONESHOT. Roda num worker. Um cliente que envia sem
+   ler não faz a saída crescer sem limite: passando de SERV_SAIDA_MAX,
+   a conexão para de ler (e sai do EPOLLIN) até o envio esvaziar. */
+static void atenderConexao(Servidor *sv, Conexao *c) {
+    int caiu = 0, vazio = 0;
+
+    while (!caiu) {
+        while (!c->encerrar && saidaPendente(c) < SERV_SAIDA_MAX) {
+            if (c->iniEntrada == c->fimEntrada) {
+                ssize_t n = recv(c->fd, c->entrada, sizeof c->entrada, 0);
+                if (n == 0) { caiu = 1; break; }
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) caiu = 1;
+                    else vazio = 1;
+                    break;
+                }
+                c->iniEntrada = 0;
+                c->fimEntrada = (int) n;
+            }
+            consumirEntrada(sv, c);
+        }
+        if (!caiu && enviarPendente(c) < 0) caiu = 1;
+        /* o envio abriu espaço: volta a processar o que ficou em entrada */
+        if (c->encerrar || vazio || saidaPendente(c) >= SERV_SAIDA_MAX) break;
+    }
+
+    if (caiu || (c->encerrar && c->saida.tam == 0)) {
+        fecharConexao(sv, c);
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLONESHOT | (saidaPendente(c) ? EPOLLOUT : 0) |
+                (c->encerrar || saidaPendente(c) >= SERV_SAIDA_MAX ? 0 : EPOLLIN);
+    ev.data.ptr = c;
+    if (epoll_ctl(sv->epfd, EPOLL_CTL_MOD, c->fd, &ev) < 0)
+        fecharConexao(sv, c);
+}
+
+static void* workerServidor(void *arg) {
+    Servidor *sv = arg;
+    for (;;) {
+        pthread_mutex_lock(&sv->trava);
+        while (!sv->filaIni && !sv->parar)
+            pthread_cond_wait(&sv->temTrabalho, &sv->trava);
+        if (!sv->filaIni) {
+            pthread_mutex_unlock(&sv->trava);
+            return NULL;
+        }
+        Conexao *c = sv->filaIni;
+        sv->filaIni = c->proxFila;
+        if (!sv->filaIni) sv->filaFim = NULL;
+        pthread_mutex_unlock(&sv->trava);
+
+        atenderConexao(sv, c);
+    }
+}
+
+static void enfileirarConexao(Servidor *sv, Conexao *c) {
+    pthread_mutex_lock(&sv->trava);
+    c->proxFila = NULL;
+    if (sv->filaFim) sv->filaFim->proxFila = c;
+    else sv->filaIni = c;
+    sv->filaFim = c;
+    pthread_cond_signal(&sv->temTrabalho);
+    pthread_mutex_unlock(&sv->trava);
+}
+
+/* A escuta é level-triggered: se accept4 falha sem consumir a conexão
+   pendente (EMFILE/ENFILE, sem memória), o epoll a acusaria de novo em
+   seguida, sem fim. Ela sai do epoll até um fd ser liberado ou o laço
+   ficar ocioso (retomarEscuta). */
+static void aceitarConexoes(Servidor *sv) {
+    for (;;) {
+        int fd = accept4(sv->escuta, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;   /* nada mais pendente */
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept4");
+            struct epoll_event ev;
+            ev.events = 0;
+            ev.data.ptr = NULL;
+            __atomic_store_n(&sv->escutaPausada, 1, __ATOMIC_RELAXED);
+            epoll_ctl(sv->epfd, EPOLL_CTL_MOD, sv->escuta, &ev);
+            return;
+        }
+
+        Conexao *c = calloc(1, sizeof(Conexao));
+        if (!c) exit(1);
+        c->fd = fd;
+        c->estado = ESTADO_MENU;
+        inicializarInvestigacao(&c->inv);
+
+        /* entra na lista antes do epoll: um worker pode fechá-la logo */
+        pthread_mutex_lock(&sv->trava);
+        c->prox = sv->abertas;
+        if (sv->abertas) sv->abertas->ant = c;
+        sv->abertas = c;
+        sv->ativas++;
+        pthread_mutex_unlock(&sv->trava);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr = c;
+        if (epoll_ctl(sv->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) fecharConexao(sv, c);
+    }
+}
+
+/* Roda até SIGINT/SIGTERM. A mansão e a hash não podem mudar depois
+   daqui: o pool de strings é congelado antes de subir os workers. */
+int executarServidor(const MansaoPlana *m, HashTable *ht, const TabelaConcorrente *catalogo,
+                     const char *caminho, int nThreads) {
+    struct sockaddr_un end;
+    if (strlen(caminho) >= sizeof end.sun_path) {
+        fprintf(stderr, "Caminho de socket longo demais: %s\n", caminho);
+        return 1;
+    }
+
+    Servidor sv;
+    memset(&sv, 0, sizeof sv);
+    sv.m = m;
+    sv.ht = ht;
+    sv.catalogo = catalogo;
+
+    sv.escuta = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sv.escuta < 0) { perror("socket"); return 1; }
+    memset(&end, 0, sizeof end);
+    end.sun_family = AF_UNIX;
+    strcpy(end.sun_path, caminho);
+    unlink(caminho);
+    if (bind(sv.escuta, (struct sockaddr*) &end, sizeof end) < 0 || listen(sv.escuta, SOMAXCONN) < 0) {
+        perror("bind/listen");
+        close(sv.escuta);
+        return 1;
+    }
+
+    sv.epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;   /* NULL = socket de escuta */
+    epoll_ctl(sv.epfd, EPOLL_CTL_ADD, sv.escuta, &ev);
+
+    congelarInternos();
+    pthread_mutex_init(&sv.trava, NULL);
+    pthread_cond_init(&sv.temTrabalho, NULL);
+
+    if (nThreads <= 0) nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (nThreads <= 0) nThreads = 1;
+    pthread_t *workers = malloc(nThreads * sizeof(pthread_t));
+    if (!workers) exit(1);
+    for (int i = 0; i < nThreads; i++)
+        pthread_create(&workers[i], NULL, workerServidor, &sv);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof sa);
+    sa.sa_handler = tratarSinalServidor;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    fprintf(stderr, "Servidor em %s com %d workers\n", caminho, nThreads);
+
+    struct epoll_event eventos[SERV_MAX_EVENTOS];
+    while (!pararServidor) {
+        int n = epoll_wait(sv.epfd, eventos, SERV_MAX_EVENTOS, 500);
+        if (n == 0) retomarEscuta(&sv);
+        for (int i = 0; i < n; i++) {
+            if (eventos[i].data.ptr == NULL) aceitarConexoes(&sv);
+            else enfileirarConexao(&sv, eventos[i].data.ptr);
+        }
+    }
+
+    pthread_mutex_lock(&sv.trava);
+    sv.parar = 1;
+    pthread_cond_broadcast(&sv.temTrabalho);
+    pthread_mutex_unlock(&sv.trava);
+    for (int i = 0; i < nThreads; i++)
+        pthread_join(workers[i], NULL);
+    free(workers);
+
+    /* os workers já saíram: o que sobrou na lista é só desta thread */
+    long abertas = sv.ativas;
+    while (sv.abertas) fecharConexao(&sv, sv.abertas);
+    fprintf(stderr, "Servidor encerrado (%ld conexões abertas fechadas)\n", abertas);
+    close(sv.escuta);
+    close(sv.epfd);
+    unlink(caminho);
+    pthread_mutex_destroy(&sv.trava);
+    pthread_cond_destroy(&sv.temTrabalho);
+    return 0;
+}
+
+#else
+
+int executarServidor(const MansaoPlana *m, HashTable *ht, const TabelaConcorrente *catalogo,
+                     const char *caminho, int nThreads) {
+    (void) m; (void) ht; (void) catalogo; (void) caminho; (void) nThreads;
+    fprintf(stderr, "Modo servidor disponível apenas no Linux (epoll).\n");
+    return 1;
+}
+
+#endif
+
+/* ==========================
+   MAIN
+   Opções de linha de comando:
+     --mansao ARQ            carrega a mansão de um arquivo .dqm
+     --passagens ARQ         passagens extras entre salas, uma por linha:
+                             "origem destino peso" (índices de sala)
+     --exportar-mansao ARQ   grava a mansão atual em ARQ e encerra
+     --catalogo ARQ [T]      associa as pistas das salas pelo catálogo ARQ
+                             ("pista;suspeito"), carregado com T threads
+     --lote ARQ              reproduz sessões gravadas (ARQ "-" = stdin);
+                             cada sessão é a sequência de opções até o 0
+                             do menu principal
+     --bench N [DIST]        microbenchmarks com N chaves (ver BENCHMARK)
+     --gerar PREFIXO N FORMA M S [DIST [SEMENTE]]
+                             grava PREFIXO.dqm (N salas) e
+                             PREFIXO-catalogo.txt (M pistas, S suspeitos)
+                             sintéticos (ver GERADOR E TESTE DE ESCALA)
+     --escala N FORMA M S [DIST [SEMENTE [SESSOES]]]
+                             gera o mesmo mundo em memória e joga SESSOES
+                             sessões nele, com uma linha JSON por fase
+     --servidor SOCK [T]     atende sessões num socket Unix com T workers
+     --resolver [T]          analisa todos os caminhos da mansão (T threads)
+     --carregar ARQ          retoma a investigação salva em ARQ (.dqs); a
+                             opção "Salvar" do menu grava de volta nele
+     --gerar-hash-perfeita CAT  escreve em stdout o catalogo_pistas.h
+                             para o catálogo CAT ("pista;suspeito")
+   Com DQ_STATS no ambiente, as estatísticas de INSTRUMENTAÇÃO vão para
+   stderr ao final do jogo ou do servidor.
+   ========================== */
+
+int main(int argc, char **argv) {
+    const char *arqMansao = NULL, *arqExportar = NULL, *arqLote = NULL;
+    const char *arqCarregar = NULL, *arqPassagens = NULL;
+    const char *sockServidor = NULL, *arqCatalogo = NULL;
+    int threadsServidor = 0, threadsCatalogo = 0;
+    int resolver = 0, threadsResolver = 0;
+    if (getenv("DQ_STATS")) estatAtiva = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mansao") == 0 && i + 1 < argc)
+            arqMansao = argv[++i];
+        else if (strcmp(argv[i], "--exportar-mansao") == 0 && i + 1 < argc)
+            arqExportar = argv[++i];
+        else if (strcmp(argv[i], "--lote") == 0 && i + 1 < argc)
+            arqLote = argv[++i];
+        else if (strcmp(argv[i], "--passagens") == 0 && i + 1 < argc)
+            arqPassagens = argv[++i];
+        else if (strcmp(argv[i], "--carregar") == 0 && i + 1 < argc)
+            arqCarregar = arqSalvamento = argv[++i];
+        else if (strcmp(argv[i], "--catalogo") == 0 && i + 1 < argc) {
+            arqCatalogo = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                threadsCatalogo = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--resolver") == 0) {
+            resolver = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                threadsResolver = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--servidor") == 0 && i + 1 < argc) {
+            sockServidor = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                threadsServidor = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--gerar-hash-perfeita") == 0 && i + 1 < argc)
+            return gerarHashPerfeita(argv[++i], stdout);
+        else if ((strcmp(argv[i], "--gerar") == 0 && i + 5 < argc) ||
+                 (strcmp(argv[i], "--escala") == 0 && i + 4 < argc)) {
+            int escala = strcmp(argv[i], "--escala") == 0;
+            const char *prefixo = escala ? NULL : argv[++i];
+            Mundo w = { atoi(argv[i + 1]), argv[i + 2], atoi(argv[i + 3]), atoi(argv[i + 4]),
+                        "uniforme", 1 };
+            i += 4;
+            int sessoes = ESCALA_SESSOES;
+            if (i + 1 < argc && argv[i + 1][0] != '-') w.dist = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-') w.semente = strtoull(argv[++i], NULL, 10);
+            if (escala && i + 1 < argc && argv[i + 1][0] != '-') sessoes = atoi(argv[++i]);
+            inicializarInternos();
+            int r = escala ? executarEscala(&w, sessoes) : gerarArquivosMundo(&w, prefixo);
+            liberarInternos();
+            return r;
+        }
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            int n = atoi(argv[++i]);
+            const char *dist = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "aleatoria";
+            inicializarInternos();
+            int r = executarBenchmark(n, dist);
+            liberarInternos();
+            return r;
+        }
+        else {
+            fprintf(stderr, "Uso: %s [--mansao ARQ] [--passagens ARQ] [--exportar-mansao ARQ]\n"
+                            "       [--catalogo ARQ [THREADS]] [--lote ARQ] [--carregar ARQ]\n"
+                            "       [--bench N [DIST]]\n"
+                            "       [--gerar PREFIXO N FORMA M S [DIST [SEMENTE]]]\n"
+                            "       [--escala N FORMA M S [DIST [SEMENTE [SESSOES]]]]\n"
+                            "       [--servidor SOCK [THREADS]] [--resolver [THREADS]]\n"
+                            "       [--gerar-hash-perfeita CATALOGO]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Leitor *leitor = NULL;
+    if (arqLote) {
+        leitor = malloc(sizeof(Leitor));
+        if (!leitor) exit(1);
+        leitor->f = strcmp(arqLote, "-") == 0 ? stdin : fopen(arqLote, "rb");
+        if (!leitor->f) {
+            fprintf(stderr, "Erro ao abrir o lote %s\n", arqLote);
+            free(leitor);
+            return 1;
+        }
+        leitor->pos = leitor->tam = 0;
+        entradaLote = leitor;
+        modoLote = 1;
+        setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+    }
+
+    inicializarInternos();
+
+    HashTable ht;
+    inicializarHash(&ht);
+
+    carregarCatalogoEstatico(&ht);
+
+    Arena arenaMansao;
+    inicializarArena(&arenaMansao);
+    MansaoPlana mansao;
+    if (arqMansao) {
+        if (carregarMansao(&arenaMansao, arqMansao, &mansao) != 0) {
+            fprintf(stderr, "Erro ao carregar a mansão de %s\n", arqMansao);
+            liberarHash(&ht);
+            liberarArena(&arenaMansao);
+            liberarInternos();
+            return 1;
+        }
+    } else {
+        /* a árvore de Salas só serve de molde para a versão plana */
+        Arena arenaMolde;
+        inicializarArena(&arenaMolde);
+        planificarMansao(&arenaMansao, montarMansao(&arenaMolde), &mansao);
+        liberarArena(&arenaMolde);
+    }
+
+    TabelaConcorrente catalogo;
+    int temCatalogo = 0;
+    if (arqCatalogo) {
+        if (carregarCatalogoParalelo(&catalogo, arqCatalogo, threadsCatalogo) != 0) {
+            fprintf(stderr, "Erro ao carregar o catálogo de %s\n", arqCatalogo);
+            liberarHash(&ht);
+            liberarArena(&arenaMansao);
+            liberarInternos();
+            return 1;
+        }
+        importarCatalogo(&ht, &catalogo, &mansao);
+        /* só o servidor consulta o catálogo depois da carga */
+        if (sockServidor && !arqExportar && !resolver) temCatalogo = 1;
+        else liberarTabelaConcorrente(&catalogo);
+    }
+
+    if (arqExportar) {
+        int erro = salvarMansao(&mansao, arqExportar);
+        if (erro) fprintf(stderr, "Erro ao gravar a mansão em %s\n", arqExportar);
+        liberarHash(&ht);
+        liberarArena(&arenaMansao);
+        liberarInternos();
+        return erro ? 1 : 0;
+    }
+
+    if (resolver) {
+        int r = resolverMansao(&mansao, &ht, threadsResolver);
+        liberarHash(&ht);
+        liberarArena(&arenaMansao);
+        liberarInternos();
+        return r;
+    }
+
+    if (sockServidor) {
+        int r = executarServidor(&mansao, &ht, temCatalogo ? &catalogo : NULL,
+                                 sockServidor, threadsServidor);
+        if (estatAtiva) relatarEstatisticas(stderr, &ht, NULL);
+        if (temCatalogo) liberarTabelaConcorrente(&catalogo);
+        liberarHash(&ht);
+        liberarArena(&arenaMansao);
+        liberarInternos();
+        return r;
+    }
+
+    GrafoMansao grafo;
+    if (grafoDaMansao(&grafo, &mansao, arqPassagens) != 0) {
+        fprintf(stderr, "Erro ao ler as passagens de %s\n", arqPassagens);
+        liberarHash(&ht);
+        liberarArena(&arenaMansao);
+        liberarInternos();
+        return 1;
+    }
+    mansao.grafo = &grafo;
+
+    Investigacao inv;
+    inicializarInvestigacao(&inv);
+    if (arqCarregar) {
+        if (carregarInvestigacao(&inv, &mansao, &ht, arqCarregar) == 0)
+            SAIDA("Investigação retomada em: %s\n", textoInterno(mansao.nomes[inv.salaAtual]));
+        else
+            fprintf(stderr, "Não foi possível retomar %s; começando do zero\n", arqCarregar);
+    }
+
+    if (modoLote) {
+        /* uma sessão por 0 no menu; a investigação recomeça do zero */
+        long num = 0;
+        while (jogarSessao(&mansao, &ht, &inv)) {
+            relatarSessao(++num, &inv);
+            liberarInvestigacao(&inv);
+        }
+        if (inv.pistas || inv.acusado != -1)
+            relatarSessao(++num, &inv);   /* última sessão sem o 0 final */
 
-        if (opc == 1) explorar(mansao, &ht, &pistas);
-        else if (opc == 2) exibirPistasInOrder(pistas);
-        else if (opc == 3) fazerAcusacao(pistas, &ht);
-        else if (opc == 0) break;
-        else printf("Opção inválida\n");
+        if (leitor->f != stdin) fclose(leitor->f);
+        free(leitor);
+    } else {
+        jogarSessao(&mansao, &ht, &inv);
     }
 
+    if (estatAtiva) relatarEstatisticas(stderr, &ht, &inv);
     liberarHash(&ht);
-    liberarPistasBST(pistas);
+    liberarInvestigacao(&inv);
+    liberarGrafo(&grafo);
+    liberarArena(&arenaMansao);
+    liberarInternos();
 
-    printf("Encerrando Detective Quest.\n");
+    SAIDA("Encerrando Detective Quest.\n");
     return 0;
 }